@@ -34,25 +34,213 @@
 #include <random>
 #include <chrono>
 #include <cstdint> // uint32_t
-#include <sstream> // reading integer from string
+#include <cstring> // memchr
 #include <fstream>
+#include <fcntl.h> // the log is mapped into memory
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "unionfind.h" // incremental winner detection
 using namespace std;
 
+// a piece of the log, which stays mapped until the report is written
+struct LogText {
+	const char *begin{nullptr}, *end{nullptr};
+};
+
+ostream &operator<<(ostream &os, const LogText &t) {
+	return os.write(t.begin, t.end - t.begin);
+}
+
 // used in game analysis
 struct Move {
 	unsigned short row, col;
-	int time_ms;
+	int time_ms{0};
 	char color; // can be 'X' or 'O'
 };
 
 struct Match {
 	unsigned short board_side;
-	string match_id; // string identifying the match
-	string x_id, o_id; // strings identifying each player
+	LogText match_id; // line identifying the match
+	LogText x_id, o_id; // strings identifying each player
 	vector<Move> move; // vector of all moves during this match
 	char winner{' '}; // can be 'X' or 'O'
 };
 
+// the whole log file mapped into memory, so it is scanned in place instead
+// of being copied into a string line by line. Pipes and other files that
+// cannot be mapped are read into memory instead
+class LogFile {
+	void *map{MAP_FAILED};
+	size_t length{0};
+	vector<char> data; // the log when it is not mapped
+public:
+	LogFile() {}
+	LogFile(const LogFile &) = delete;
+	LogFile &operator=(const LogFile &) = delete;
+	~LogFile() {
+		if(map != MAP_FAILED) {
+			munmap(map, length);
+		}
+	}
+	bool open(const char *path) {
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			length = st.st_size;
+			if(length) {
+				map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd,
+					0);
+			}
+			if(map != MAP_FAILED) {
+				// the log is read once from start to end
+				madvise(map, length, MADV_SEQUENTIAL);
+			}
+		}
+		if(map == MAP_FAILED) {
+			char buf[65536];
+			ssize_t n;
+			while((n = read(fd, buf, sizeof(buf))) > 0) {
+				data.insert(data.end(), buf, buf + n);
+			}
+			length = data.size();
+		}
+		::close(fd);
+		return true;
+	}
+	const char *begin() const {
+		return map != MAP_FAILED? static_cast<const char *>(map):
+			data.data();
+	}
+	const char *end() const {
+		return begin() + length;
+	}
+	size_t size() const {
+		return length;
+	}
+};
+
+// reads the Match records and the moves of their games from the log in
+// place: line ends are found with memchr and numbers are read straight
+// from the text, so nothing is allocated per line
+class LogScanner {
+	const char *p, *end; // the next line, the end of the log
+	vector<Move> moves; // of the game being read, reused for every game
+	// the end of the line that starts at p, without its line break
+	const char *line_end() const {
+		const char *e = static_cast<const char *>(memchr(p, '\n', end - p));
+		if(!e) {
+			e = end;
+		}
+		if(e > p && e[-1] == '\r') {
+			--e;
+		}
+		return e;
+	}
+	// moves p to the start of the line after the one ending at e
+	void next_line(const char *e) {
+		p = e < end && *e == '\r'? e + 1: e;
+		p = p < end? p + 1: end;
+	}
+	static bool is_digit(char c) {
+		return c >= '0' && c <= '9';
+	}
+	static const char *skip_space(const char *s, const char *e) {
+		while(s < e && (*s == ' ' || *s == '\t')) {
+			++s;
+		}
+		return s;
+	}
+	static const char *token_end(const char *s, const char *e) {
+		while(s < e && *s != ' ' && *s != '\t') {
+			++s;
+		}
+		return s;
+	}
+	// the number the digits at s start, 0 if there are none
+	static unsigned read_number(const char *s, const char *e) {
+		unsigned n = 0;
+		for(; s < e && is_digit(*s) && n < 100000000; ++s) {
+			n = n * 10 + (*s - '0');
+		}
+		return n;
+	}
+public:
+	LogScanner(const char *begin, const char *end) : p(begin), end(end) {}
+	// skips to the next line starting with M and makes it the id of m.
+	// Match_<side> sets board_side, a side out of 3..30 is taken as 11,
+	// a plain Match keeps the side of the match before. False at the end
+	// of the log
+	bool next_match(Match &m, unsigned short &board_side) {
+		while(p < end) {
+			const char *e = line_end();
+			if(e == p || *p != 'M') {
+				next_line(e);
+				continue;
+			}
+			m.match_id.begin = p;
+			m.match_id.end = e;
+			if(token_end(p, e) - p > 6) {
+				unsigned side = read_number(skip_space(p + 6, e), e);
+				board_side = side < 3 || side > 30? 11: side;
+			}
+			m.board_side = board_side;
+			next_line(e);
+			return true;
+		}
+		return false;
+	}
+	// reads the handshakes and moves of the game that follows the Match
+	// line into m, up to the first line that does not belong to the game:
+	// an empty line, a line that does not start with X or O, a player
+	// quitting with X. or O., or a move that is too short
+	void read_game(Match &m) {
+		moves.clear();
+		while(p < end) {
+			const char *b = p, *e = line_end();
+			if(e == b || (*b != 'X' && *b != 'O')) {
+				break;
+			}
+			if(e - b > 1 && b[1] == ':') { // handshake
+				if(e - b > 3) {
+					LogText &id = *b == 'O'? m.o_id: m.x_id;
+					id.begin = b + 3;
+					id.end = e;
+				}
+				next_line(e);
+				continue;
+			}
+			if(e - b > 1 && b[1] == '.') {
+				break;
+			}
+			// Xa10 #14 t=358ms or Oa11.#14 t=330ms
+			if(e - b < 3 || b[1] == ' ' || b[1] == '\t' || b[2] == ' ' ||
+				b[2] == '\t') {
+				break;
+			}
+			Move mv;
+			mv.color = *b;
+			mv.col = b[1] - 'a';
+			mv.row = read_number(b + 2, e) - 1;
+			// the time is the first name=value word, found by memchr
+			// rather than by splitting the line into words
+			const char *q = static_cast<const char *>(memchr(b + 2, '=',
+				e - b - 2));
+			if(q && q[-1] == 't' && (q[-2] == ' ' || q[-2] == '\t')) {
+				bool minus = q + 1 < e && q[1] == '-';
+				int ms = read_number(q + 1 + minus, e);
+				mv.time_ms = minus? -ms: ms;
+			}
+			moves.push_back(mv);
+			next_line(e);
+		}
+		m.move.assign(moves.begin(), moves.end()); // one allocation
+	}
+};
+
 // Board does the Monte-Carlo simulations, its field is optimized for
 // quick determining of the winner.
 class Board {
@@ -70,6 +258,7 @@ class Board {
 	vector<uint32_t> blackrow, whitecol; // bitmaps storing the stones as
 		// single bits in a row: each row is 32-
 	char winner; // ' '=game is running, 'X' or 'O' means game is over
+	WinTracker links; // connected groups of stones, knows the winner
 	bool whites_move; // whose move is it now? 1 if whites
 	bool black_ai; // is black player played by AI?
 	bool white_ai; // is white player played by AI?
@@ -120,6 +309,7 @@ public:
 		blackrow.resize(side); // initialize to zero the blackrow vector
 		whitecol.clear();
 		whitecol.resize(side);
+		links.reset(side);
 		winner = ' '; // game is running
 		whites_move = false; // black starts
 		black_ai = aiblack; // is black to be played by computer?
@@ -236,12 +426,9 @@ public:
 		return true;
 	}
 	// checks if game is over and sets winner to X=black or O=white
+	// links is updated with every stone, so this takes O(1)
 	void check_game_over() {
-		if(is_connected(blackrow)) { // check black side
-			winner = 'X';
-		} else if(is_connected(whitecol)) { // check white side
-			winner = 'O';
-		}
+		winner = links.winner();
 	}
 	// checks if white would win in current stones configuration
 	bool is_white_winning() {
@@ -316,6 +503,7 @@ public:
 			// update whitecol
 			whitecol[(*cur0) % side] |=
 				uint32_t(1) << ((*cur0) / side);
+			links.place(max / side, max % side, 'O');
 			cur0++;
 		} else {
 			--cur1;
@@ -364,6 +552,7 @@ public:
 			// update blackrow
 			blackrow[(*cur1) / side] |=
 				uint32_t(1) << ((*cur1) % side);
+			links.place(max / side, max % side, 'X');
 		}
 		return max;
 	}
@@ -373,7 +562,7 @@ public:
 			return -100;
 		}
 		// check bounds
-		if(row > side || col > side) {
+		if(row >= side || col >= side) {
 			cout << (int)col << " error " << (int)row << endl;
 			return -1; // error: one of the values is out of bounds
 		}
@@ -388,6 +577,7 @@ public:
 		{
 			// update blackrow:
 			blackrow[row] |= uint32_t(1) << col;
+			links.place(row, col, 'X');
 			// we must also update stone vector
 			auto it = find(cur0, cur1, ind);
 			// we must swap two stones
@@ -400,6 +590,7 @@ public:
 		{
 			// update whitecol:
 			whitecol[col] |= uint32_t(1) << row;
+			links.place(row, col, 'O');
 			auto it = find(cur0, cur1, ind);
 			// we must swap two stones
 			*it = *cur0;
@@ -580,66 +771,14 @@ public:
 		return 0;
 	}
 
-	void analyze(Match &m, ifstream &ifile) {
+	void analyze(Match &m, LogScanner &log) {
 		if(!init_success) {
 			return;
 		}
-		// get the players id's
-		char color; // color of the current movea
-		string line;
-		unsigned short row, col;
-		while(ifile.good()) {
-			getline(ifile, line);
-			if(!line.size()) {
-				break; // should be no empty lines during match
-			}
-			color = line[0];
-			if(color != 'O' && color != 'X') {
-				break; // game is probably over
-			}
-			if(line[1] == ':' && line.size() > 3) {
-				if(color == 'O') {
-					m.o_id = line.substr(3);
-				} else {
-					m.x_id = line.substr(3);
-				}
-				continue;
-			}
-			if(line[1] == '.') {
-				break;
-			}
-			// parse the move
-			stringstream ss(line);
-			string s, s1, s2, s3;
-			ss >> s1 >> s2 >> s3;
-			if(s1.size() < 3) {
-				break;
-			}
-			col = s1[1] - 'a';
-			s = s1.substr(2);
-			ss.str(s);
-			ss.clear();
-			ss >> row;
-			Move mv;
-			mv.row = row - 1;
-			mv.col = col;
-			mv.color = color;
-			// read time
-			if(s2.size() && s2[0] == 't' && s2[1] == '=') {
-				s = s2.substr(2);
-				ss.str(s);
-				ss.clear();
-				ss >> mv.time_ms;
-			} else if(s3.size() && s3[0] == 't' && s3[1] == '=') {
-				s = s3.substr(2);
-				ss.str(s);
-				ss.clear();
-				ss >> mv.time_ms;
-			}
-			m.move.push_back(mv);
-		}
+		// get the players id's and the moves
+		log.read_game(m);
 		// now that all moves are stored, proceed analyzing the game
-		for(auto mv : m.move) {
+		for(auto &mv : m.move) {
 			if(int e = try_move(mv.row, mv.col)) {
 				switch(e) {
 				case -1:
@@ -680,8 +819,8 @@ main(int argc, char *argv[]) {
 			<< "Example: " << argv[0] << " log.txt report.html\n";
 		return 0;
 	}
-	ifstream ifile(argv[1]);
-	if(!ifile) {
+	LogFile log;
+	if(!log.open(argv[1])) {
 		cerr << "can't open input file " << argv[1] << "\n";
 		return -1;
 	}
@@ -694,40 +833,28 @@ main(int argc, char *argv[]) {
 	vector<Match>match; // we store data of each match separately
 	// read the log file and collect data into match vector
 	size_t x_wins = 0, o_wins = 0;
-	while(ifile.good()) {
-		string line;
-		getline(ifile, line);
-		if(!line.size() || line[0] != 'M') {
-			continue;
-		}
-		Match m; // create a match
-		m.match_id = line; // set match id
-		// determine board size
-		stringstream ss(line);
-		string s;
-		ss >> s;
-		if(s.size() > 6) {
-			line = line.substr(6);
-			ss.str(line);
-			ss.clear();
-			ss >> board_side;
-			if(board_side < 3 || board_side > 30) {
-				board_side = 11;
-			}
-		}
-		m.board_side = board_side;
-		Board board(board_side, 0, 0);
-		board.analyze(m, ifile);
+	auto start = chrono::steady_clock::now();
+	LogScanner scanner(log.begin(), log.end());
+	Board board; // reset for every match
+	Match m;
+	while(scanner.next_match(m, board_side)) {
+		board.reset(board_side, 0, 0);
+		board.analyze(m, scanner);
 		if(m.winner == 'X') {
 			++x_wins;
 		}
 		if(m.winner == 'O') {
 			++o_wins;
 		}
-		match.push_back(m);
+		match.push_back(move(m));
+		m = Match();
 	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() -
+		start).count();
 	cout << "X wins: " << x_wins << " O wins: " << o_wins <<
 		" Unfinished: " << match.size() - x_wins - o_wins << endl;
+	cout << "Read " << log.size() / 1e6 << " MB in " << seconds << " s, " <<
+		log.size() / 1e6 / max(seconds, 1e-9) << " MB/s" << endl;
 	// generate report
 	ofile << "<!DOCTYPE html><html><head>\n"
 		"<meta http-equiv=\"Content-Type\" "
@@ -740,7 +867,7 @@ main(int argc, char *argv[]) {
 		"\nvar data = { ";
 	// generate json
 	ofile << "\"match\": [ ";
-	for(auto ma : match) {
+	for(auto &ma : match) {
 		ofile << " { ";
 		ofile << "\"match_id\": \"" << ma.match_id << "\",\n" <<
 			"\"o_id\": \"" << ma.o_id << "\",\n" <<
@@ -749,13 +876,13 @@ main(int argc, char *argv[]) {
 			"\"winner\": \"" << ma.winner << "\",\n";
 		// output moves
 		ofile << "\"move\": [ ";
-			for(auto mv : ma.move) {
+			for(auto &mv : ma.move) {
 				ofile << "\"" << char(mv.col + 'a') <<
 					(mv.row + 1) << "\", ";
 			}
 		ofile << " ],\n";
 		ofile << "\"time_ms\": [ ";
-			for(auto mv : ma.move) {
+			for(auto &mv : ma.move) {
 				ofile << "\"" << mv.time_ms << "\", ";
 			}
 		ofile << " ] },\n";
@@ -0,0 +1,143 @@
+// Opening book shared by hexai.cpp and hex.cpp, written by bookgen.cpp.
+// The file is a 16 byte header followed by entries sorted by key, in the
+// byte order of the machine that wrote it:
+//   header: "HEXBOOK1", board side (uint32), number of entries (uint32)
+//   entry:  position key (uint64), move (uint16), unused (uint16),
+//           playouts the move was chosen with (uint32)
+// The file is mapped into memory as it is and searched in place, so
+// opening it costs nothing however large it is, and a lookup is a binary
+// search of a few cache lines.
+// The key of a position is the canonical_key() of transposition.h, the
+// smaller of its zobrist hash and the hash of the position turned by 180
+// degrees. A position and its rotation share one entry, whose move belongs
+// to the position with the smaller hash, so book_key() also tells whether
+// the move has to be turned.
+#ifndef BOOK_H
+#define BOOK_H
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "transposition.h" // zobrist_key, canonical_key
+
+struct BookEntry {
+	uint64_t key; // book_key() of the position
+	uint16_t move; // tile to play in the position with the smaller hash
+	uint16_t unused;
+	uint32_t playouts; // how much search went into the move
+};
+
+struct BookHeader {
+	char magic[8]; // "HEXBOOK1"
+	uint32_t side;
+	uint32_t count;
+};
+
+// key of a position with zobrist hash h whose rotation has hash r. Sets
+// turned if the book's moves have to be turned for this position
+inline uint64_t book_key(uint64_t h, uint64_t r, bool &turned) {
+	turned = r < h;
+	return canonical_key(h, r);
+}
+
+class OpeningBook {
+	void *map{MAP_FAILED}; // the whole file
+	size_t length{0};
+	const BookEntry *entries{nullptr};
+	size_t count{0};
+	unsigned side{0};
+public:
+	OpeningBook() {}
+	OpeningBook(const OpeningBook &) = delete;
+	OpeningBook &operator=(const OpeningBook &) = delete;
+	~OpeningBook() {
+		close();
+	}
+	// maps a book for boards of the given side, false if the file cannot
+	// be read or is not such a book
+	bool open(const char *path, unsigned board_side) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BookHeader)) {
+			length = st.st_size;
+			map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if(map == MAP_FAILED) {
+			return false;
+		}
+		const BookHeader *h = static_cast<const BookHeader *>(map);
+		if(memcmp(h->magic, "HEXBOOK1", 8) || h->side != board_side ||
+			sizeof(BookHeader) + h->count * sizeof(BookEntry) > length) {
+			close();
+			return false;
+		}
+		entries = reinterpret_cast<const BookEntry *>(h + 1);
+		count = h->count;
+		side = h->side;
+		return true;
+	}
+	void close() {
+		if(map != MAP_FAILED) {
+			munmap(map, length);
+		}
+		map = MAP_FAILED;
+		length = 0;
+		entries = nullptr;
+		count = 0;
+	}
+	bool is_open() const {
+		return entries != nullptr;
+	}
+	size_t size() const {
+		return count;
+	}
+	// the book move of the position with hash h and rotated hash r, as a
+	// tile of that position; false if the position is not in the book
+	bool find(uint64_t h, uint64_t r, size_t &move) const {
+		bool turned;
+		uint64_t key = book_key(h, r, turned);
+		const BookEntry *e = std::lower_bound(entries, entries + count,
+			key, [](const BookEntry &a, uint64_t k) {
+				return a.key < k;
+			});
+		if(e == entries + count || e->key != key) {
+			return false;
+		}
+		move = turned? side * side - 1 - e->move: e->move;
+		return true;
+	}
+};
+
+// writes a book file, false on error. Sorts the entries by key
+inline bool write_book(const char *path, unsigned side,
+		std::vector<BookEntry> &book) {
+	std::sort(book.begin(), book.end(),
+		[](const BookEntry &a, const BookEntry &b) {
+			return a.key < b.key;
+		});
+	FILE *f = fopen(path, "wb");
+	if(!f) {
+		return false;
+	}
+	BookHeader h;
+	memcpy(h.magic, "HEXBOOK1", 8);
+	h.side = side;
+	h.count = book.size();
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+		fwrite(book.data(), sizeof(BookEntry), book.size(), f) ==
+		book.size();
+	return fclose(f) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,184 @@
+// Builds an opening book for hexai and hex (book=<file>), see book.h.
+// to compile: g++ -O3 -std=c++11 -pthread -o bookgen bookgen.cpp
+// usage: bookgen <book file> [<board side>] [<plies>] [<iterations>]
+//	[<threads>] [search=flat|halving|mcts] [amaf=on|off]
+// example: bookgen book11.bin 11 3 20000 0
+// The book has a move for every position of the first <plies> plies that a
+// player who follows the book can meet, for both colors: X's book answers
+// every reply of O to its own book moves, O's book answers every move of X.
+// Each of these positions gets a deep search of hexai (iterations per
+// candidate, spread over the threads), so this is meant to run once,
+// offline, with many more iterations than a game could afford. Positions
+// that are the same up to a turn of the board by 180 degrees are searched
+// only once, like transpositions.
+// With 121 tiles and 3 plies this is 1 + 120 positions for X and 61 for O.
+// Every further ply multiplies the positions of one color by about the side
+// squared, so 4 plies already take some 7000 searches.
+#define HEXAI_NO_MAIN
+#include "hexai.cpp"
+#include <map>
+#include <set>
+
+class BookBuilder {
+	unique_ptr<Board> board;
+	unsigned side;
+	size_t plies; // positions with fewer stones than this get a move
+	size_t iter; // iterations per candidate of every search
+	map<uint64_t, BookEntry> entries; // by key
+	set<uint64_t> expanded; // keys of positions whose replies are done
+	vector<size_t> line; // moves from the empty board to this position
+	// sets up the position after line, returns false if it is over
+	bool setup() {
+		board->reset(true, true);
+		for(auto mv : line) {
+			board->play_move(mv);
+		}
+		return board->get_winner() == ' ';
+	}
+	// the book move of the position after line, searched if it is new
+	size_t book_move() {
+		bool turned;
+		uint64_t key = board->position_key(turned);
+		auto it = entries.find(key);
+		if(it != entries.end()) {
+			size_t mv = it->second.move;
+			return turned? side * side - 1 - mv: mv;
+		}
+		auto start = chrono::steady_clock::now();
+		size_t mv = board->make_move();
+		double secs = chrono::duration<double>(
+			chrono::steady_clock::now() - start).count();
+		BookEntry e = BookEntry();
+		e.key = key;
+		e.move = turned? side * side - 1 - mv: mv;
+		e.playouts = (side * side - line.size()) * iter;
+		entries[key] = e;
+		cerr << entries.size() << ": ";
+		for(auto m : line) {
+			cerr << char(m % side + 'a') << m / side + 1 << ' ';
+		}
+		cerr << "-> " << char(mv % side + 'a') << mv / side + 1 <<
+			" (" << secs << "s)\n";
+		return mv;
+	}
+	// walks the positions of the book of one player, white if white is set
+	void walk(bool white) {
+		if(line.size() >= plies || !setup()) {
+			return;
+		}
+		if((line.size() % 2 == 1) == white) { // our move
+			line.push_back(book_move());
+			walk(white);
+			line.pop_back();
+			return;
+		}
+		bool turned;
+		if(!expanded.insert(board->position_key(turned)).second) {
+			return; // seen in another order or turned around
+		}
+		vector<bool> taken(side * side);
+		for(auto mv : line) {
+			taken[mv] = true;
+		}
+		for(size_t mv = 0; mv < side * side; ++mv) {
+			if(!taken[mv]) {
+				line.push_back(mv);
+				walk(white);
+				line.pop_back();
+			}
+		}
+	}
+public:
+	BookBuilder(unsigned side, size_t plies, size_t iter, size_t threads,
+			Board::Search search, bool amaf) :
+			board(Board::create(side, true, true)), side(side),
+			plies(plies),
+			iter(iter) {
+		board->set_threads(threads);
+		board->set_iterations(iter);
+		board->set_amaf(amaf, 1000);
+		board->set_search(search);
+	}
+	// searches the positions of both colors and writes the book
+	bool build(const char *path) {
+		walk(false);
+		expanded.clear();
+		walk(true);
+		vector<BookEntry> book;
+		for(auto &e : entries) {
+			book.push_back(e.second);
+		}
+		return write_book(path, side, book);
+	}
+	size_t size() const {
+		return entries.size();
+	}
+};
+
+int main(int argc, char *argv[]) {
+	unsigned short side = 11;
+	size_t plies = 2;
+	size_t iter = 10000;
+	size_t threads = 0;
+	Board::Search search = Board::flat;
+	bool amaf = false;
+	int nargs = 1;
+	for(int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		if(arg == "search=flat") {
+			search = Board::flat;
+		} else if(arg == "search=halving") {
+			search = Board::halving;
+		} else if(arg == "search=mcts") {
+			search = Board::mcts;
+		} else if(arg == "amaf=on" || arg == "amaf=off") {
+			amaf = arg == "amaf=on";
+		} else if(arg.find('=') != string::npos) {
+			cerr << "E: unknown option " << arg << '\n';
+			return -1;
+		} else {
+			argv[nargs++] = argv[i];
+		}
+	}
+	if(nargs < 2) {
+		cerr << "usage: " << argv[0] << " <book file> [<board side>] "
+			"[<plies>] [<iterations>] [<threads>] "
+			"[search=flat|halving|mcts] [amaf=on|off]\n";
+		return -1;
+	}
+	switch(nargs > 6? 6: nargs) {
+	case 6:
+	{
+		stringstream ss(argv[5]);
+		ss >> threads;
+	}
+	case 5:
+	{
+		stringstream ss(argv[4]);
+		ss >> iter;
+	}
+	case 4:
+	{
+		stringstream ss(argv[3]);
+		ss >> plies;
+	}
+	case 3:
+	{
+		stringstream ss(argv[2]);
+		ss >> side;
+		side = side < 3? 3: side;
+	}
+	}
+	if(side > MAX_SIDE) {
+		cerr << "E: bookgen is built for boards up to " << MAX_SIDE << 'x' <<
+			MAX_SIDE << ", see -DMAX_SIDE\n";
+		return -1;
+	}
+	BookBuilder builder(side, plies, iter, threads, search, amaf);
+	if(!builder.build(argv[1])) {
+		cerr << "E: cannot write " << argv[1] << '\n';
+		return -1;
+	}
+	cerr << builder.size() << " positions written to " << argv[1] << '\n';
+	return 0;
+}
@@ -0,0 +1,276 @@
+// Benchmark of the win checks of hexai.cpp and hex.cpp on the same boards.
+// to compile: g++ -O3 -std=c++11 -pthread -o connbench connbench.cpp
+// usage: connbench [<boards>] [<seed>] [<ms per kernel>]
+// example: connbench 4096 1 200
+// Every kernel that decides whether the stones of one color connect its two
+// edges is run on the same random boards: <boards> boards (4096 by default)
+// for each side and density below, where density is the share of the tiles
+// that hold a stone of the color, so 0.5 is what the playouts of a full
+// board see. The boards come from a fixed seed (1 by default), so runs can
+// be compared. The kernels:
+//  rowscan  hexai's SizedBoard::is_connected, row by row with while loops
+//  lanes    hexai's connected_lanes, the same scan on PLAYOUT_LANES boards
+//           at once without data dependent loops
+//  flood    the whole-board flood fill of floodfill.h, sides up to 11
+//  fsm      hex.cpp's _isEndGame state machine, which also walks back up
+//  unionfind  the WinTracker of unionfind.h, fed the stones one by one
+// For each one it prints the time per check, checks per second, branch
+// misses per check (from the hardware counters through perf_event_open,
+// n/a where the kernel does not allow it) and the number of boards on
+// which it disagrees with a plain breadth-first search. The row scans only
+// follow stones from one row to the next, so they miss paths that turn back
+// towards the first row and are expected to disagree on a few boards; every
+// other kernel must agree on all of them, and connbench returns 1 if one
+// does not.
+#define MAX_SIDE 16 // no larger sides are benchmarked
+#define HEXAI_NO_MAIN
+#include "hexai.cpp"
+#define HEX_NO_MAIN
+#include "hex.cpp"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the branch misses of this thread in user space, between start() and
+// stop()
+class BranchMisses {
+	int fd;
+public:
+	BranchMisses() {
+		perf_event_attr a;
+		memset(&a, 0, sizeof(a));
+		a.type = PERF_TYPE_HARDWARE;
+		a.size = sizeof(a);
+		a.config = PERF_COUNT_HW_BRANCH_MISSES;
+		a.disabled = 1;
+		a.exclude_kernel = 1;
+		a.exclude_hv = 1;
+		fd = syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+	}
+	~BranchMisses() {
+		if(fd >= 0) {
+			close(fd);
+		}
+	}
+	bool available() const {
+		return fd >= 0;
+	}
+	void start() {
+		if(fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+	uint64_t stop() {
+		uint64_t count = 0;
+		if(fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if(read(fd, &count, sizeof(count)) != sizeof(count)) {
+				count = 0;
+			}
+		}
+		return count;
+	}
+};
+
+volatile uint64_t sink; // keeps the results of the timed loops alive
+
+// true if the stones of rows (bit c of row r is tile (r, c)) connect the
+// first row to the last, by a breadth-first search over the tiles
+bool reference_connected(const uint32_t *rows, int side) {
+	vector<int> queue;
+	vector<bool> seen(side * side);
+	for(int c = 0; c < side; ++c) {
+		if(rows[0] >> c & 1) {
+			queue.push_back(c);
+			seen[c] = true;
+		}
+	}
+	static const int dr[6] = {0, 0, -1, -1, 1, 1};
+	static const int dc[6] = {-1, 1, 0, 1, -1, 0};
+	for(size_t i = 0; i < queue.size(); ++i) {
+		int r = queue[i] / side, c = queue[i] % side;
+		if(r == side - 1) {
+			return true;
+		}
+		for(int k = 0; k < 6; ++k) {
+			int nr = r + dr[k], nc = c + dc[k];
+			if(nr >= 0 && nr < side && nc >= 0 && nc < side &&
+				!seen[nr * side + nc] && rows[nr] >> nc & 1) {
+				seen[nr * side + nc] = true;
+				queue.push_back(nr * side + nc);
+			}
+		}
+	}
+	return false;
+}
+
+// what one kernel did on the boards of a side and density
+struct KernelResult {
+	const char *name;
+	double ns; // per check
+	double misses; // branch misses per check, < 0 if unknown
+	size_t wrong; // boards on which it disagrees with the reference
+	bool exact; // must agree on every board
+};
+
+// runs check(b) on boards [0, n) in steps of per_call boards, check
+// returns how many of them are connected, and compares the answers of
+// answer(b) with expect. The timed passes repeat until ms have passed
+template<class Check, class Answer>
+KernelResult run_kernel(const char *name, bool exact, Check check,
+		Answer answer, size_t n, size_t per_call,
+		const vector<bool> &expect, double ms, BranchMisses &bm) {
+	KernelResult k = {name, 0, -1, 0, exact};
+	for(size_t b = 0; b < n; ++b) {
+		k.wrong += answer(b) != expect[b];
+	}
+	uint64_t sum = 0, misses = 0;
+	size_t checks = 0;
+	auto start = chrono::steady_clock::now();
+	double elapsed = 0;
+	while(elapsed < ms) {
+		bm.start();
+		for(size_t b = 0; b < n; b += per_call) {
+			sum += check(b);
+		}
+		misses += bm.stop();
+		checks += n;
+		elapsed = chrono::duration<double, milli>(
+			chrono::steady_clock::now() - start).count();
+	}
+	sink = sum;
+	k.ns = elapsed * 1e6 / checks;
+	if(bm.available()) {
+		k.misses = double(misses) / checks;
+	}
+	return k;
+}
+
+// benchmarks every kernel on n boards of side Side at each density,
+// returns false if an exact kernel disagreed with the reference
+template<int Side>
+bool bench_side(size_t n, uint64_t seed, double ms, BranchMisses &bm) {
+	static const double densities[] = {0.3, 0.5, 0.7};
+	bool ok = true;
+	SizedBoard<Side> hexai(false, false);
+	for(double density : densities) {
+		mt19937_64 rng(seed * 1000003 + Side * 1000 +
+			uint64_t(density * 100));
+		bernoulli_distribution stone(density);
+		// the same boards in the layout of every kernel
+		vector<array<uint32_t, Side> > rows(n);
+		vector<PlayerState<Side> > states(n);
+		vector<uint32_t> batch(n * Side);
+		vector<bool> expect(n);
+		size_t connected = 0;
+		for(size_t b = 0; b < n; ++b) {
+			for(int r = 0; r < Side; ++r) {
+				uint32_t row = 0;
+				for(int c = 0; c < Side; ++c) {
+					row |= uint32_t(stone(rng)) << c;
+				}
+				rows[b][r] = row;
+				states[b][r] = row;
+				size_t first = b - b % PLAYOUT_LANES;
+				batch[first * Side + r * PLAYOUT_LANES +
+					b % PLAYOUT_LANES] = row;
+			}
+			expect[b] = reference_connected(rows[b].data(), Side);
+			connected += expect[b];
+		}
+		vector<KernelResult> results;
+		auto rowscan = [&](size_t b) -> bool {
+			return hexai.is_connected(rows[b]);
+		};
+		results.push_back(run_kernel("rowscan", false, rowscan, rowscan,
+			n, 1, expect, ms, bm));
+		auto lanes = [&](size_t b) -> size_t {
+			uint32_t c[PLAYOUT_LANES];
+			connected_lanes<Side>(&batch[b * Side], c);
+			size_t k = 0;
+			for(int l = 0; l < PLAYOUT_LANES; ++l) {
+				k += c[l] != 0;
+			}
+			return k;
+		};
+		auto lane = [&](size_t b) -> bool {
+			uint32_t c[PLAYOUT_LANES];
+			size_t first = b - b % PLAYOUT_LANES;
+			connected_lanes<Side>(&batch[first * Side], c);
+			return c[b % PLAYOUT_LANES] != 0;
+		};
+		results.push_back(run_kernel("lanes", false, lanes, lane, n,
+			PLAYOUT_LANES, expect, ms, bm));
+		if(Side <= 11) {
+			auto flood = [&](size_t b) -> bool {
+				return flood_connected(rows[b].data(), Side);
+			};
+			results.push_back(run_kernel("flood", true, flood, flood,
+				n, 1, expect, ms, bm));
+		}
+		auto fsm = [&](size_t b) -> bool {
+			return _isEndGame<Side>(states[b], 0);
+		};
+		results.push_back(run_kernel("fsm", true, fsm, fsm, n, 1, expect,
+			ms, bm));
+		WinTracker tracker;
+		auto unionfind = [&](size_t b) -> bool {
+			tracker.reset(Side);
+			for(int r = 0; r < Side; ++r) {
+				for(uint32_t m = rows[b][r]; m; m &= m - 1) {
+					tracker.place(r, __builtin_ctz(m), 'X');
+				}
+			}
+			return tracker.winner() == 'X';
+		};
+		results.push_back(run_kernel("unionfind", true, unionfind,
+			unionfind, n, 1, expect, ms, bm));
+		cout << "side " << Side << ", density " << fixed <<
+			setprecision(2) << density << ", " << n << " boards, " <<
+			setprecision(1) << 100.0 * connected / n << "% connected\n";
+		cout << "  kernel      ns/check  Mchecks/s  misses/check  wrong\n";
+		for(auto &k : results) {
+			cout << "  " << left << setw(10) << k.name << right <<
+				setprecision(1) << setw(10) << k.ns << setw(11) <<
+				1000 / k.ns;
+			if(k.misses < 0) {
+				cout << setw(14) << "n/a";
+			} else {
+				cout << setprecision(3) << setw(14) << k.misses;
+			}
+			cout << setw(7) << k.wrong << '\n';
+			ok = ok && (!k.exact || !k.wrong);
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	size_t n = 4096;
+	uint64_t seed = 1;
+	double ms = 200;
+	if(argc > 1) {
+		stringstream(argv[1]) >> n;
+	}
+	if(argc > 2) {
+		stringstream(argv[2]) >> seed;
+	}
+	if(argc > 3) {
+		stringstream(argv[3]) >> ms;
+	}
+	n = max<size_t>(n - n % PLAYOUT_LANES, PLAYOUT_LANES); // whole batches
+	BranchMisses bm;
+	bool ok = bench_side<5>(n, seed, ms, bm);
+	ok = bench_side<7>(n, seed, ms, bm) && ok;
+	ok = bench_side<9>(n, seed, ms, bm) && ok;
+	ok = bench_side<11>(n, seed, ms, bm) && ok;
+	ok = bench_side<13>(n, seed, ms, bm) && ok;
+	ok = bench_side<16>(n, seed, ms, bm) && ok;
+	if(!ok) {
+		cout << "an exact kernel disagrees with the reference\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Measures what hex.cpp's crn=on is worth on the positions of logged games.
+// to compile: g++ -O3 -std=c++11 -pthread -o crngain crngain.cpp
+// usage: crngain <log> [<fills>] [<every>] [<seed>]
+// example: crngain log3.txt 2000 4
+// With crn=on hex plays every random fill of the board for all of its
+// candidates, only the candidate's own cell differs. The results of two
+// candidates are then correlated, so their difference is known from fewer
+// fills than with a fill of its own for every candidate. crngain replays the
+// games of a log written by arbi or match (any side hex plays, taken from
+// the Match_<side> header, 11 by default), and on every <every>-th position
+// (4 by default) plays <fills> shared fills (2000 by default) for the player
+// to move. It prints how many separate fills one shared fill is worth when
+// the best candidate is compared with the runner-up, and the median of that
+// over all the other candidates (see MonteCarloAI::crnGain), followed by the
+// geometric means over all positions.
+#define HEX_NO_MAIN
+#include "hex.cpp"
+#include <fstream>
+#include <cmath>
+
+// a board of the side of the log and the search that measures it
+class GainMeter {
+public:
+	virtual ~GainMeter() {}
+	virtual void reset() = 0;
+	// plays tile for the player to move, false if it is taken
+	virtual bool play(size_t tile) = 0;
+	virtual bool over() const = 0;
+	// the gains of crnGain for the player to move, false if there is
+	// nothing to compare
+	virtual bool measure(uint32_t fills, double &median,
+		double &runner_up) = 0;
+};
+
+template<int Size>
+class SizedGainMeter : public GainMeter {
+public:
+	SizedGainMeter(uint32_t seed) : ai(seed) {}
+	void reset() {
+		board.reset();
+		player = 0;
+		winner = false;
+	}
+	bool play(size_t tile) {
+		if(tile >= Size * Size || !board.toggle(tile, player)) {
+			return false;
+		}
+		winner = board.isEndGame(player);
+		player ^= 1;
+		return true;
+	}
+	bool over() const {
+		return winner;
+	}
+	bool measure(uint32_t fills, double &median, double &runner_up) {
+		median = ai.crnGain(board, player, fills, runner_up);
+		return median > 0;
+	}
+private:
+	GameBoard<Size> board;
+	MonteCarloAI<GameBoard<Size> > ai;
+	uint32_t player = 0; // to move, 0 = X
+	bool winner = false;
+};
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cout << "usage: crngain <log> [<fills>] [<every>] [<seed>]\n";
+		return 1;
+	}
+	uint32_t fills = 2000, every = 4, seed = 1;
+	if(argc > 2) {
+		stringstream(argv[2]) >> fills;
+	}
+	if(argc > 3) {
+		stringstream(argv[3]) >> every;
+	}
+	if(argc > 4) {
+		stringstream(argv[4]) >> seed;
+	}
+	every = max<uint32_t>(every, 1);
+	ifstream ifile(argv[1]);
+	if(!ifile) {
+		cout << "E: cannot open " << argv[1] << '\n';
+		return 1;
+	}
+	unique_ptr<GainMeter> meter;
+	uint32_t side = 0, ply = 0;
+	bool skip = true; // no game, or a move of it was illegal
+	size_t games = 0, positions = 0, runner_ups = 0;
+	double log_median = 0, log_runner_up = 0;
+	cout << "game  ply  empty  runner-up  median\n";
+	string line;
+	while(getline(ifile, line)) {
+		if(line.compare(0, 5, "Match") == 0) {
+			// a new game, Match_<side> or just Match for 11x11
+			uint32_t s = 11;
+			if(line.size() > 6 && line[5] == '_') {
+				stringstream(line.substr(6)) >> s;
+			}
+			if(s != side || !meter) {
+				meter.reset(createSized<GainMeter, SizedGainMeter>(s,
+					seed));
+				side = s;
+			}
+			skip = !meter;
+			if(skip) {
+				cout << "E: no board of side " << s << '\n';
+				continue;
+			}
+			meter->reset();
+			ply = 0;
+			++games;
+			continue;
+		}
+		if(skip || line.size() < 3 || (line[0] != 'X' && line[0] != 'O') ||
+			line[1] < 'a' || line[1] > 'z') {
+			continue; // handshakes, quits and anything else
+		}
+		if(meter->over() || line[0] != (ply % 2? 'O': 'X')) {
+			continue; // moves logged after the end or out of turn
+		}
+		uint32_t col = line[1] - 'a', row = 0;
+		stringstream(line.substr(2)) >> row;
+		if(ply % every == 0) {
+			double median, runner_up;
+			if(meter->measure(fills, median, runner_up)) {
+				cout << setw(4) << games << setw(5) << ply << setw(7) <<
+					side * side - ply << fixed << setprecision(2) <<
+					setw(11) << runner_up << setw(8) << median << '\n';
+				if(runner_up > 0) {
+					log_runner_up += log(runner_up);
+					++runner_ups;
+				}
+				log_median += log(median);
+				++positions;
+			}
+		}
+		if(col >= side || row < 1 || row > side ||
+			!meter->play((row - 1) * side + col)) {
+			cout << "E: illegal move " << line << " in game " << games <<
+				'\n';
+			skip = true;
+			continue;
+		}
+		++ply;
+	}
+	if(!positions) {
+		cout << "no positions to measure\n";
+		return 1;
+	}
+	cout << positions << " positions of " << games << " games, " << fills <<
+		" fills each, geometric means: runner-up " << fixed <<
+		setprecision(2) << exp(log_runner_up / max<size_t>(runner_ups, 1)) <<
+		", median " << exp(log_median / positions) << '\n';
+	return 0;
+}
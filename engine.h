@@ -0,0 +1,184 @@
+// Engine interface shared by hexai.cpp and hex.cpp.
+// An engine knows the position of one game and can search it: new_game()
+// starts from the empty board, apply_move() plays a tile for the player to
+// move, whoever chose it, think() searches the position within the budget
+// set by set_budget() and the engine's own options, and best_move() is the
+// tile it found. Tiles are row * side + col, X moves first and connects the
+// top and bottom rows, O the left and right columns.
+// play_protocol() is the text protocol of the README on top of an engine,
+// so the programs only set up their engine and hand it over, and match.cpp
+// plays games between engines with plain function calls.
+#ifndef ENGINE_H
+#define ENGINE_H
+#include <iostream>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstddef>
+
+class Engine {
+public:
+	virtual ~Engine() {}
+	// program and author, sent in the handshake
+	virtual const char *name() const = 0;
+	// playouts per candidate, or ms per move and/or ms for the whole game
+	// when they are not 0
+	virtual void set_budget(size_t iterations, double move_ms = 0,
+		double game_ms = 0) = 0;
+	// empty board, X to move
+	virtual void new_game() = 0;
+	// plays tile for the player to move, false if it is taken or off the
+	// board
+	virtual bool apply_move(size_t tile) = 0;
+	// searches the position for the player to move
+	virtual void think() = 0;
+	// the tile found by the last think()
+	virtual size_t best_move() const = 0;
+	// thinks on the opponent's time until stop is set
+	virtual void ponder(const std::atomic<bool> &stop) {}
+	// ' ' while the game is running, else the color that has won
+	virtual char get_winner() const = 0;
+	// tiles the last think() filled in with prune=on
+	virtual size_t get_pruned() const {
+		return 0;
+	}
+};
+
+// plays one game of the text protocol on cin and cout for color with
+// engine e, see the README. ponder makes the engine think while waiting
+// for the opponent's move, show_pruned adds p=<n> to every move. Returns 0
+// when the game is over, or negative after an error in the input
+inline int play_protocol(Engine &e, char color, unsigned short board_side,
+		bool ponder = false, bool show_pruned = false) {
+	using namespace std;
+	char column; // letter representing board column from a-z
+	unsigned short col; // numeric column
+	unsigned short row; // numeric row
+	char c; // used for input processing
+	size_t move; // our move
+	e.new_game();
+	// send handshake message color: name of program by author
+	// this string should uniquely identify the player
+	cout << color << ": " << e.name() << '\n' << flush;
+	if(color == 'X') {
+		// wait for other player's handshake message
+		cin >> c; // should be the other player's color
+		if(c != 'O') {
+			cout << "X. E: expecting handshake message "
+				"from O\n" << flush;
+			return -2;
+		}
+		cin >> c; // should be ':'
+		if(c != ':') {
+			cout << "X. E: expecting : after O in "
+				"handshake message\n" << flush;
+			return -3;
+		}
+		// ignore the rest of the line
+		cin.clear();
+		cin.ignore(numeric_limits<streamsize>::max(), '\n');
+		// start the timer
+		auto start = chrono::steady_clock::now();
+		// make a move
+		e.think();
+		move = e.best_move();
+		e.apply_move(move);
+		// stop the timer
+		auto end = chrono::steady_clock::now();
+		int tmilli = chrono::duration<double, milli>
+			(end - start).count();
+		cout << color << char((move % board_side) + 'a') <<
+			(move / board_side + 1) << " #1 t=" << tmilli << "ms";
+		if(show_pruned) {
+			cout << " p=" << e.get_pruned();
+		}
+		cout << '\n' << flush;
+	}
+	int counter = 1; // count the moves
+	while(e.get_winner() == ' ') {
+		if(ponder) {
+			// think until the other player's next line arrives,
+			// peek() waits for it without reading anything
+			atomic<bool> input(false);
+			thread reader([&input]() {
+				cin.peek();
+				input = true;
+			});
+			e.ponder(input);
+			reader.join();
+		}
+		cin >> c; // other player color
+		cin >> column; // lower case letter represenging column
+		if(!cin) {
+			break; // the other player is gone
+		}
+		if(c != (color == 'O'? 'X': 'O') || column == ':') {
+			cin.clear();
+			cin.ignore(numeric_limits<streamsize>::max(), '\n');
+			continue;
+		}
+		if(column == '.') { // the other player quits, game over
+			break;
+		}
+		col = column - 'a';
+		if(col >= board_side) {
+			cout << color <<  ". E: " << color <<
+				" received illegal column: '" << c << "'\n";
+			return -4;
+		}
+		cin >> row;
+		if(row > board_side) {
+			cout << color << ". E: " << color <<
+				" received illegal row: '" << row << "'\n";
+			return -5;
+		}
+		c = cin.peek();
+		if(c == '.') { // dot at the end of the other player's
+			// move means that he wins,
+			// or maybe he gives up - game over
+			break;
+		}
+		cin.clear();
+		cin.ignore(numeric_limits<streamsize>::max(), '\n');
+		// start the timer
+		auto start = chrono::steady_clock::now();
+		// register the opponent's move
+		if(!e.apply_move((row - 1) * board_side + col)) {
+			cout << color << ". E: received illegal move " <<
+				column << row << '\n';
+			return -6;
+		}
+		if(e.get_winner() != ' ') {
+			break;
+		}
+		if(color == 'X') {
+			++counter;
+		}
+		// make a move. If I won, add a dot and exit.
+		e.think();
+		move = e.best_move();
+		e.apply_move(move);
+		bool over = e.get_winner() != ' ';
+		// stop the timer
+		auto end = chrono::steady_clock::now();
+		int tmilli = chrono::duration<double, milli>
+			(end - start).count();
+		cout << color << char((move % board_side) + 'a') <<
+			(move / board_side + 1) << (over? '.': ' ') << '#' <<
+			counter << " t=" << tmilli << "ms";
+		if(show_pruned) {
+			cout << " p=" << e.get_pruned(); // candidates filled in
+		}
+		cout << '\n' << flush;
+		if(over) {
+			break;
+		}
+		if(color == 'O') {
+			++counter;
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// Whole-board connectivity check for boards up to 11x11, shared by hexai.cpp
+// and hex.cpp.
+// The stones of one color are stored in a single 128 bit number, tile (r, c)
+// at bit r * S + c, where r counts the rows between the two edges the color
+// has to connect. Both engines already keep a color in this orientation:
+// hexai's blackrow/whitecol and hex.cpp's PlayerState hold one S-bit row per
+// element, and flood_pack() just lays them one after another.
+// Tile (r, c) touches (r, c - 1), (r, c + 1), (r - 1, c), (r - 1, c + 1),
+// (r + 1, c) and (r + 1, c - 1), the same neighbours as the row scan:
+// ((A and B) or ((A >> 1) and B)). Instead of walking row by row, the set of
+// stones reached from the first row is grown by OR-ing its six neighbour
+// shifts together and masking with the stones, until it touches the last row
+// or stops growing. There is no per-row loop and no special case for either
+// color.
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+#include <cstdint>
+
+typedef unsigned __int128 Bits128;
+
+// masks for a board of side S
+template<int S>
+struct FloodMasks {
+	static_assert(S >= 3 && S * S <= 128, "board must fit in 128 bits");
+	static constexpr Bits128 one = 1;
+	static constexpr Bits128 row(int r) {
+		return ((one << S) - 1) << (r * S);
+	}
+	static constexpr Bits128 col(int c, int r = 0) {
+		return r == S? 0: (one << (r * S + c)) | col(c, r + 1);
+	}
+	static constexpr Bits128 first_row = row(0);
+	static constexpr Bits128 last_row = row(S - 1);
+	// stones that may move one column left or right without leaving
+	// their row
+	static constexpr Bits128 not_first_col = ((one << (S * S)) - 1) &
+		~col(0);
+	static constexpr Bits128 not_last_col = ((one << (S * S)) - 1) &
+		~col(S - 1);
+};
+
+// packs S rows of S bits each into one 128 bit board
+template<int S, class Row>
+inline Bits128 flood_pack(const Row *rows) {
+	Bits128 b = 0;
+	for(int r = 0; r < S; ++r) {
+		b |= Bits128(rows[r]) << (r * S);
+	}
+	return b;
+}
+
+// all tiles that touch a tile of x, plus x itself
+template<int S>
+inline Bits128 flood_step(Bits128 x) {
+	typedef FloodMasks<S> M;
+	Bits128 l = x & M::not_first_col; // can go to c - 1
+	Bits128 r = x & M::not_last_col; // can go to c + 1
+	return x | (x << S) | (x >> S) | (r << 1) | (l >> 1) |
+		(l << (S - 1)) | (r >> (S - 1));
+}
+
+// true if the stones connect the first row with the last one
+template<int S>
+bool flood_connected(Bits128 stones) {
+	typedef FloodMasks<S> M;
+	Bits128 x = stones & M::first_row; // stones reached so far
+	Bits128 prev = 0;
+	while(x != prev) {
+		if(x & M::last_row) {
+			return true;
+		}
+		prev = x;
+		x = flood_step<S>(x) & stones;
+	}
+	return false;
+}
+
+// drop-in replacement for the row scans of both engines
+template<int S, class Row>
+inline bool flood_connected(const Row *rows) {
+	return flood_connected<S>(flood_pack<S>(rows));
+}
+
+// runtime side version for code that does not know the side at compile
+// time, sides above 11 return false
+template<class Row>
+bool flood_connected(const Row *rows, int side) {
+	switch(side) {
+	case 3: return flood_connected<3>(rows);
+	case 4: return flood_connected<4>(rows);
+	case 5: return flood_connected<5>(rows);
+	case 6: return flood_connected<6>(rows);
+	case 7: return flood_connected<7>(rows);
+	case 8: return flood_connected<8>(rows);
+	case 9: return flood_connected<9>(rows);
+	case 10: return flood_connected<10>(rows);
+	case 11: return flood_connected<11>(rows);
+	}
+	return false;
+}
+
+#endif
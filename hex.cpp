@@ -14,6 +14,17 @@
 #include <sstream>
 #include <limits>
 #include <locale>
+#include <type_traits>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include "floodfill.h"
+#include "timecontrol.h"
+#include "transposition.h"
+#include "book.h"
+#include "inferior.h"
+#include "engine.h"
+#include "workerpool.h"
 using namespace std;
 
 template<int Size>
@@ -110,6 +121,30 @@ bool _isEndGame(const PlayerState<Size>& player_state, uint32_t player) noexcept
   }
 }
 
+/*
+  End game check for the full boards of the Monte-Carlo simulation. Where
+  the board fits into 128 bits the flood fill of floodfill.h is used: on
+  full 11x11 boards it takes about a third of the time of the state machine
+  above, which is faster only on sparse boards.
+ */
+template<int Size>
+bool _isFullEndGame(const PlayerState<Size>& player_state, uint32_t player,
+                    std::true_type) noexcept {
+  return flood_connected<Size>(player_state.data());
+}
+
+template<int Size>
+bool _isFullEndGame(const PlayerState<Size>& player_state, uint32_t player,
+                    std::false_type) noexcept {
+  return _isEndGame<Size>(player_state, player);
+}
+
+template<int Size>
+bool _isFullEndGame(const PlayerState<Size>& player_state,
+                    uint32_t player) noexcept {
+  return _isFullEndGame<Size>(player_state, player,
+      std::integral_constant<bool, Size * Size <= 128>());
+}
 
 template<int Size>
 class AIBitBoard {
@@ -127,7 +162,7 @@ public:
   }
 
   bool isEndGame(uint32_t player) const noexcept {
-    return _isEndGame<size>(_state, player);
+    return _isFullEndGame<size>(_state, player);
   }
 
 private:
@@ -172,7 +207,7 @@ public:
   }
 
   bool isEndGame(uint32_t player) const noexcept {
-    return _isEndGame<11>(_players[player], player);
+    return _isEndGame<Size>(_players[player], player);
   }
 
   const PlayerState<size>& getPlayerState(uint32_t player) const noexcept {
@@ -199,7 +234,7 @@ std::ostream& operator<<(std::ostream& o, const BitBoard<Size>& b) noexcept {
 
   for (uint32_t i = 0; i < Size; ++i) {
     // indentation
-    for (int s = 0; s < i; ++s) {
+    for (uint32_t s = 0; s < i; ++s) {
       o << "  ";
     }
     o << std::setw(2) << i+1;
@@ -242,8 +277,12 @@ public:
   }
 
   void reset() noexcept {
+    _board.reset();
     std::iota(std::begin(_freeNodes), std::end(_freeNodes), 0);
     _freeNodesIndex = _freeNodes;
+    _freeNodesCount = size * size;
+    _hash = 0;
+    _rotatedHash = 0;
   }
 
   bool toggle(uint32_t id, uint32_t player) noexcept {
@@ -252,15 +291,33 @@ public:
     }
 
     _board.toggle(id, player);
-    id = _freeNodesIndex[id];
-    std::swap(_freeNodes[id], _freeNodes[--_freeNodesCount]);
-    std::swap(_freeNodesIndex[id], _freeNodesIndex[_freeNodesCount]);
+    _hash ^= zobrist_key(id, player);
+    _rotatedHash ^= zobrist_key(size * size - 1 - id, player);
+
+    // move the last free node into the slot of id, _freeNodesIndex is
+    // indexed by node id
+    uint32_t slot = _freeNodesIndex[id];
+    uint32_t last = --_freeNodesCount;
+    uint16_t moved = _freeNodes[last];
+    _freeNodes[slot] = moved;
+    _freeNodes[last] = id;
+    _freeNodesIndex[moved] = slot;
+    _freeNodesIndex[id] = last;
 
     return true;
   }
 
   bool toggle(uint32_t row, uint32_t col, uint32_t player) noexcept {
-    return toggle(row * size + col);
+    return toggle(row * size + col, player);
+  }
+
+  uint64_t getHash() const noexcept {
+    return _hash;
+  }
+
+  // hash of the board turned by 180 degrees, see book.h
+  uint64_t getRotatedHash() const noexcept {
+    return _rotatedHash;
   }
 
   bool isToggled(uint32_t id) const noexcept {
@@ -291,6 +348,8 @@ private:
   std::array<uint16_t, size * size> _freeNodes;
   std::array<uint16_t, size * size> _freeNodesIndex;
   uint32_t _freeNodesCount = size * size;
+  uint64_t _hash = 0; // zobrist hash of the stones on the board
+  uint64_t _rotatedHash = 0; // the same for the board turned around
 };
 
 template<int Size>
@@ -302,6 +361,14 @@ std::ostream& operator<<(std::ostream& os, const GameBoard<Size>& b) noexcept {
   return os;
 }
 
+/*
+  How the iterations of a move are shared among the candidate positions
+ */
+enum class Search : uint8_t {
+  Flat,   // every candidate gets all iterations, with an early cutoff
+  Halving // same total, spent by successive halving
+};
+
 template<class B>
 class MonteCarloAI {
 private:
@@ -319,106 +386,745 @@ private:
     }
   };
 
+  /*
+    What a search thread plays its playouts with
+   */
+  struct Worker {
+    AIBitBoard<B::size> board;
+    std::mt19937 rng;
+    std::array<Position, B::size * B::size> freeNodes;
+    std::array<uint32_t, B::size * B::size> wins; // of _sharedFills
+    std::array<uint8_t, B::size * B::size> won; // of the last _sharedFill
+  };
+
 public:
   using gameBoardType = B;
   static const uint32_t boardSize = B::size;
+  static const uint32_t cellCount = boardSize * boardSize;
+
+  MonteCarloAI(uint32_t seed)
+      : _ponderWins(cellCount * cellCount),
+        _ponderVisits(cellCount * cellCount),
+        _workers(1) {
+    _workers[0].rng.seed(seed);
+  }
+
+  /*
+    Number of threads of the search, 0 means one per hardware core. Each
+    one plays its own share of the candidates with its own board, free
+    nodes and random engine, seeded from the first one
+   */
+  void setThreads(uint32_t n) {
+    if (!n) {
+      n = std::thread::hardware_concurrency();
+      n = n ? n : 1;
+    }
+    _pool.reset(); // stop the old threads before touching the workers
+    _workers.resize(n);
+    for (uint32_t t = 1; t < n; ++t) {
+      _workers[t].rng.seed(_workers[0].rng());
+    }
+    if (n > 1) {
+      _pool.reset(new WorkerPool(n));
+    }
+  }
+
+  void setSearch(Search search) noexcept {
+    _search = search;
+  }
+
+  void setClock(const MoveClock& clock) noexcept {
+    _clock = clock;
+  }
 
-  MonteCarloAI(uint32_t seed) : _rng(seed) {}
+  void setTableSize(size_t megabytes) {
+    _tt.resize(megabytes);
+  }
+
+  bool setBook(const char* path) {
+    return _book.open(path, boardSize);
+  }
+
+  void setPrune(bool prune) noexcept {
+    _prune = prune;
+  }
+
+  /*
+    Common random numbers: every fill of the flat and halving searches is
+    shared by all the candidates, see _sharedFills
+   */
+  void setCrn(bool crn) noexcept {
+    _crn = crn;
+  }
+
+  uint32_t getPruned() const noexcept {
+    return _pruned;
+  }
 
   uint32_t getNextMove(gameBoardType& board, uint32_t player, uint32_t iterations) {
+    _pruned = 0;
+    size_t book_move;
+    if (_book.is_open() &&
+        _book.find(board.getHash(), board.getRotatedHash(), book_move) &&
+        book_move < cellCount && !board.isToggled(book_move)) {
+      return book_move;
+    }
+
     auto start = std::chrono::steady_clock::now();
 
+    // never more than cellCount, but gcc cannot tell on small boards
+    uint32_t free_nodes_count = std::min<uint32_t>(board.getFreeNodesCount(),
+                                                   uint32_t(cellCount));
+    std::array<Position, cellCount> free_nodes;
+    std::array<Position, cellCount> free_nodes_copy;
+
+    auto& nodes = board.getFreeNodes();
+
+    for (uint32_t i = 0; i < free_nodes_count; ++i) {
+      free_nodes[i] = _toPosition(nodes[i], player);
+    }
+
+    free_nodes_copy = free_nodes;
+
+    PlayerState<boardSize> state = board.getBoard().getPlayerState(player);
+    if (_prune) {
+      _pruned = _fillIn(board, player, free_nodes.data(),
+                        free_nodes_copy.data(), free_nodes_count, state);
+    }
+
+    // the playouts of every worker shuffle its own copy
+    for (auto& w : _workers) {
+      w.freeNodes = free_nodes;
+    }
+
+    Position win_pos = free_nodes_copy[0];
+    uint32_t moves = (free_nodes_count - 2) / 2 + player;
+
+    std::array<uint32_t, cellCount> wins;
+    std::array<uint32_t, cellCount> visits;
+    std::fill(wins.begin(), wins.begin() + free_nodes_count, 0);
+    std::fill(visits.begin(), visits.begin() + free_nodes_count, 0);
+    bool seeded = _takePonder(board, free_nodes_copy.data(),
+                              free_nodes_count, wins, visits);
+
+    // what is known about the position after each candidate
+    if (_tt.enabled()) {
+      for (uint32_t p = 0; p < free_nodes_count; ++p) {
+        uint32_t w, v;
+        if (_tt.probe(_hashAfter(board, free_nodes_copy[p], player), w, v)) {
+          wins[p] += w;
+          visits[p] += v;
+          seeded = true;
+        }
+      }
+    }
+
+    if (_clock.enabled()) {
+      _clock.start(free_nodes_count, boardSize * boardSize);
+    }
+
+    if (_search == Search::Halving) {
+      win_pos = _halving(state, free_nodes_copy.data(), free_nodes_count,
+                         moves, iterations, wins, visits);
+    } else if (_clock.enabled() || seeded || _tt.enabled() || _crn) {
+      win_pos = _flat(state, free_nodes_copy.data(), free_nodes_count,
+                      moves, iterations, wins, visits);
+    } else {
+      win_pos = _flatCutoff(state, free_nodes_copy.data(), free_nodes_count,
+                            moves, iterations);
+    }
+
+    if (_tt.enabled()) {
+      for (uint32_t p = 0; p < free_nodes_count; ++p) {
+        _tt.store(_hashAfter(board, free_nodes_copy[p], player),
+                  wins[p], visits[p]);
+      }
+    }
+
+    if (_clock.enabled()) {
+      _clock.stop();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    auto diff = end - start;
+//    std::cout << "time:" << std::chrono::duration<double, std::milli>(diff).count() << std::endl;
+
+    return _toId(win_pos, player);
+  }
+
+  /*
+    Thinks on the opponent's time until stop is set. Every playout of a
+    candidate of ours is a random game in which the opponent's stones are
+    spread at random, so it is also a valid playout of that candidate after
+    each of those stones as the opponent's reply. Its result is counted for
+    all of them, and once the real reply is known getNextMove starts from
+    the exact statistics of every candidate against it.
+   */
+  void ponder(gameBoardType& board, uint32_t player, const std::atomic<bool>& stop) {
     uint32_t free_nodes_count = board.getFreeNodesCount();
-    Position free_nodes[free_nodes_count];
-    Position free_nodes_copy[free_nodes_count];
+    _ponderCount = 0;
+    if (free_nodes_count < 3) {
+      return;
+    }
 
     auto& nodes = board.getFreeNodes();
+    std::array<Position, cellCount> free_nodes;
 
-    for (int i = 0; i < free_nodes_count; ++i) {
-      uint32_t id = nodes[i];
-      uint8_t row, col;
-      if (player) {
-        row = id % boardSize;
-        col = id / boardSize;
-      } else {
-        row = id / boardSize;
-        col = id % boardSize;
+    for (uint32_t i = 0; i < free_nodes_count; ++i) {
+      _ponderIds[i] = nodes[i];
+      _ponderNodes[i] = free_nodes[i] = _toPosition(nodes[i], player);
+    }
+    std::fill(_ponderWins.begin(), _ponderWins.end(), 0);
+    std::fill(_ponderVisits.begin(), _ponderVisits.end(), 0);
+
+    Worker& w0 = _workers[0]; // the statistics are not shared
+    const PlayerState<boardSize>& state = board.getBoard().getPlayerState(player);
+    // our random stones after the reply, as getNextMove will count them
+    uint32_t moves = (free_nodes_count - 3) / 2 + player;
+
+    for (uint32_t p = 0; !stop.load(std::memory_order_relaxed);
+         p = p + 1 < free_nodes_count ? p + 1 : 0) {
+      Position pos = _ponderNodes[p];
+      uint32_t won = _playout(w0, state, pos, free_nodes.data(),
+                              free_nodes_count, moves);
+      uint32_t* w = &_ponderWins[_index(pos) * cellCount];
+      uint32_t* v = &_ponderVisits[_index(pos) * cellCount];
+
+      // _playout leaves our random stones at the end, the rest are the
+      // opponent's and pos itself, whose entry is never read
+      for (uint32_t i = 0; i < free_nodes_count - moves; ++i) {
+        uint32_t m = _index(free_nodes[i]);
+        w[m] += won;
+        v[m]++;
       }
-      free_nodes[i].row = row;
-      free_nodes[i].col = col;
+    }
+    _ponderCount = free_nodes_count;
+  }
+
+  /*
+    How much sharing the fills (setCrn) is worth on this position: plays
+    `fills` shared fills for the player and compares the candidate that won
+    most of them with every other one. With separate fills the variance of
+    the difference of two win rates is the sum of their variances, with
+    shared fills it is the variance of the difference of the two results
+    of a fill. Their ratio is how many separate fills a shared one is worth
+    for telling the two apart: the effective sample size gain. Returns the
+    median gain over the other candidates, the one against the runner-up
+    in runner_up. Pairs that never differ are left out, so this is on the
+    low side. 0 if there is nothing to compare
+   */
+  double crnGain(gameBoardType& board, uint32_t player, uint32_t fills,
+                 double& runner_up) {
+    uint32_t count = board.getFreeNodesCount();
+    runner_up = 0;
+    if (count < 3 || !fills) {
+      return 0;
     }
 
-    std::memcpy(&free_nodes_copy[0],
-                &free_nodes[0],
-                free_nodes_count * sizeof(Position));
+    Worker& w = _workers[0];
+    auto& nodes = board.getFreeNodes();
+    std::array<Position, cellCount> candidates;
+    for (uint32_t i = 0; i < count; ++i) {
+      candidates[i] = w.freeNodes[i] = _toPosition(nodes[i], player);
+    }
+    const PlayerState<boardSize>& state = board.getBoard().getPlayerState(player);
+    uint32_t moves = (count - 2) / 2 + player;
+
+    std::vector<uint8_t> results(uint64_t(fills) * count);
+    std::vector<uint32_t> wins(count, 0);
+    for (uint32_t j = 0; j < fills; ++j) {
+      _sharedFill(w, state, candidates.data(), count, count, moves);
+      for (uint32_t p = 0; p < count; ++p) {
+        results[uint64_t(j) * count + p] = w.won[p];
+        wins[p] += w.won[p];
+      }
+    }
 
-    AIBitBoard<boardSize> b;
-    uint32_t max_wins = 0;
-    Position win_pos = free_nodes_copy[0];
+    uint32_t best = std::max_element(wins.begin(), wins.end()) - wins.begin();
+    uint32_t second = cellCount;
+    std::vector<double> gains;
+    double pb = double(wins[best]) / fills;
+    for (uint32_t q = 0; q < count; ++q) {
+      if (q == best) {
+        continue;
+      }
+      uint32_t differ = 0;
+      for (uint32_t j = 0; j < fills; ++j) {
+        differ += results[uint64_t(j) * count + best] !=
+                  results[uint64_t(j) * count + q];
+      }
+      double pq = double(wins[q]) / fills;
+      double separate = pb * (1 - pb) + pq * (1 - pq);
+      double shared = double(differ) / fills - (pb - pq) * (pb - pq);
+      if (shared <= 0 || separate <= 0) {
+        continue;
+      }
+      gains.push_back(separate / shared);
+      if (second == cellCount || wins[q] > wins[second]) {
+        second = q;
+        runner_up = gains.back();
+      }
+    }
+    if (gains.empty()) {
+      return 0;
+    }
+    std::sort(gains.begin(), gains.end());
+    return gains[gains.size() / 2];
+  }
+
+private:
+  static Position _toPosition(uint32_t id, uint32_t player) noexcept {
+    Position pos;
+    if (player) {
+      pos.row = id % boardSize;
+      pos.col = id / boardSize;
+    } else {
+      pos.row = id / boardSize;
+      pos.col = id % boardSize;
+    }
+    return pos;
+  }
+
+  static uint32_t _toId(Position pos, uint32_t player) noexcept {
+    return player ? pos.col * boardSize + pos.row
+                  : pos.row * boardSize + pos.col;
+  }
+
+  static uint32_t _index(Position pos) noexcept {
+    return pos.row * boardSize + pos.col;
+  }
+
+  /*
+    Transposition table key of the position after pos, the same for the
+    position turned by 180 degrees
+   */
+  static uint64_t _hashAfter(const gameBoardType& board, Position pos,
+                             uint32_t player) noexcept {
+    uint32_t id = _toId(pos, player);
+    return canonical_key(board.getHash() ^ zobrist_key(id, player),
+                         board.getRotatedHash() ^
+                             zobrist_key(cellCount - 1 - id, player));
+  }
 
+  /*
+    Gives the dead and captured cells to the player that can have them, see
+    inferior.h: they leave the free nodes and the candidates, and ours are
+    added to state. The two lists hold the same cells, which stay in the
+    same order. Nothing changes unless at least two cells are left for the
+    playouts. Returns the number of cells filled
+   */
+  uint32_t _fillIn(const gameBoardType& board, uint32_t player,
+                   Position* free_nodes, Position* candidates,
+                   uint32_t& free_nodes_count,
+                   PlayerState<boardSize>& state) {
+    const PlayerState<boardSize>& x = board.getBoard().getPlayerState(0);
+    const PlayerState<boardSize>& o = board.getBoard().getPlayerState(1);
+    std::array<char, cellCount> cells;
+    for (uint32_t row = 0; row < boardSize; ++row) {
+      for (uint32_t col = 0; col < boardSize; ++col) {
+        cells[row * boardSize + col] = (x[row] >> col & 1) ? 'X'
+                                       : (o[col] >> row & 1) ? 'O' : ' ';
+      }
+    }
+    uint32_t filled = fill_inferior(cells.data(), boardSize);
+    if (!filled || free_nodes_count - filled < 2) {
+      return 0;
+    }
+
+    char ours = player ? 'O' : 'X';
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < free_nodes_count; ++i) {
+      Position pos = free_nodes[i];
+      char cell = cells[_toId(pos, player)];
+      if (cell == ' ') {
+        free_nodes[kept] = candidates[kept] = pos;
+        kept++;
+      } else if (cell == ours) {
+        state[pos.row] |= 1 << pos.col;
+      }
+    }
+    free_nodes_count = kept;
+    return filled;
+  }
+
+  /*
+    Copies the statistics of the last ponder() against the move that has
+    been played since into wins and visits. Fails if the position is not
+    the pondered one plus one move.
+   */
+  bool _takePonder(gameBoardType& board, Position* candidates,
+                   uint32_t free_nodes_count,
+                   std::array<uint32_t, cellCount>& wins,
+                   std::array<uint32_t, cellCount>& visits) {
+    uint32_t count = _ponderCount;
+    _ponderCount = 0;
+    if (count != board.getFreeNodesCount() + 1) {
+      return false;
+    }
+
+    uint32_t reply = cellCount;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (board.isToggled(_ponderIds[i])) {
+        if (reply != cellCount) {
+          return false;
+        }
+        reply = _index(_ponderNodes[i]);
+      }
+    }
+    if (reply == cellCount) {
+      return false;
+    }
+
+    for (uint32_t p = 0; p < free_nodes_count; ++p) {
+      wins[p] = _ponderWins[_index(candidates[p]) * cellCount + reply];
+      visits[p] = _ponderVisits[_index(candidates[p]) * cellCount + reply];
+    }
+    return true;
+  }
+
+  /*
+    One random game after the move pos on the board and with the random
+    engine of worker w: fills `moves` random free positions for the player
+    and checks if the player has won
+   */
+  static bool _playout(Worker& w, const PlayerState<boardSize>& state,
+                       Position pos, Position* free_nodes,
+                       uint32_t free_nodes_count, uint32_t moves) {
     typedef std::uniform_int_distribution<uint16_t> distr_type;
     typedef distr_type::param_type distr_param;
 
     distr_type distr;
-    uint32_t moves = (free_nodes_count - 2) / 2 + player;
+    AIBitBoard<boardSize>& b = w.board;
 
-    for (uint32_t p = 0; p < free_nodes_count; ++p) {
-      uint32_t wins = 0;
-      uint32_t possible_wins = iterations;
-      Position pos = free_nodes_copy[p];
+    b.setState(state);
+    b.toggle(pos.row, pos.col);
+
+    for (uint32_t k = 0; k < moves; ++k) {
+      using std::swap;
 
-      for (uint32_t j = 0; j < iterations; ++j) {
-        b.setState(board.getBoard().getPlayerState(player));
-        b.toggle(pos.row, pos.col);
+      uint32_t kpos = distr(w.rng, distr_param(0, (free_nodes_count - 1) - k));
+      Position id = free_nodes[kpos];
+      swap(free_nodes[kpos], free_nodes[(free_nodes_count - 1) - k]);
 
-        for (uint32_t k = 0; k < moves; ++k) {
-          using std::swap;
+      if (pos == id) {
+        k--;
+        continue;
+      }
 
-          uint32_t kpos = distr(_rng, distr_param(0, (free_nodes_count - 1) - k));
-          Position id = free_nodes[kpos];
-          swap(free_nodes[kpos], free_nodes[(free_nodes_count - 1) - k]);
+      b.toggle(id.row, id.col);
+
+    }
+    return b.isEndGame(0);
+  }
+
+  /*
+    Runs f(worker, t) for every worker t at once, the first one on the
+    calling thread and the others on the threads of _pool, which are kept
+    between calls, and waits for all of them
+   */
+  template<class F>
+  void _parallel(F f) {
+    if (!_pool) {
+      f(_workers[0], 0);
+      return;
+    }
+    _pool->run([this, &f](size_t t) { f(_workers[t], uint32_t(t)); });
+  }
 
-          if (pos == id) {
-            k--;
-            continue;
+  /*
+    Plain flat search: `iterations` playouts for every candidate, which the
+    workers take in turn. A candidate is given up as soon as it cannot beat
+    the most wins of any candidate finished so far, by any worker. Each
+    worker keeps its best candidate, and the one with the most wins is
+    played, the first in the list on a tie, like with a single thread
+   */
+  Position _flatCutoff(const PlayerState<boardSize>& state,
+                       const Position* candidates, uint32_t free_nodes_count,
+                       uint32_t moves, uint32_t iterations) {
+    uint32_t threads = _workers.size();
+    std::atomic<uint32_t> max_wins(0);
+    std::vector<uint32_t> best(threads, 0);
+    std::vector<uint32_t> best_wins(threads, 0);
+
+    _parallel([&](Worker& w, uint32_t t) {
+      for (uint32_t p = t; p < free_nodes_count; p += threads) {
+        uint32_t wins = 0;
+        uint32_t possible_wins = iterations;
+        Position pos = candidates[p];
+
+        for (uint32_t j = 0; j < iterations; ++j) {
+          if (_playout(w, state, pos, w.freeNodes.data(), free_nodes_count,
+                       moves)) {
+            wins++;
+          } else {
+            possible_wins--;
           }
 
-          b.toggle(id.row, id.col);
+          if (possible_wins < max_wins.load(std::memory_order_relaxed)) {
+            goto end_loop;
+          }
+        }
 
+        if (wins > best_wins[t]) {
+          best[t] = p;
+          best_wins[t] = wins;
+          uint32_t m = max_wins.load();
+          while (wins > m && !max_wins.compare_exchange_weak(m, wins)) {
+          }
         }
-        if (b.isEndGame(player)) {
-          wins++;
-        } else {
-          possible_wins--;
+
+      end_loop: {
         }
+      }
+    });
+
+    uint32_t win = 0;
+    for (uint32_t t = 1; t < threads; ++t) {
+      if (best_wins[t] > best_wins[win] ||
+          (best_wins[t] == best_wins[win] && best[t] < best[win])) {
+        win = t;
+      }
+    }
+    return candidates[best[win]];
+  }
+
+  /*
+    One fill shared by the candidates [0, alive) on the board of worker w:
+    the player's `moves` random stones are drawn once, as the first
+    positions of a random order of the free nodes, and every candidate is
+    scored with its own stone added. Where the candidate is one of the
+    random stones, the next position of the order takes its place, so each
+    candidate sees the same random games as with _playout, but the
+    differences between candidates are no longer buried in the noise of
+    separate fills. Sets w.won of every candidate to its result
+   */
+  static void _sharedFill(Worker& w, const PlayerState<boardSize>& state,
+                          const Position* candidates,
+                          uint32_t free_nodes_count, uint32_t alive,
+                          uint32_t moves) {
+    typedef std::uniform_int_distribution<uint16_t> distr_type;
+    typedef distr_type::param_type distr_param;
 
-        if (possible_wins < max_wins) {
-          goto end_loop;
+    distr_type distr;
+    Position* nodes = w.freeNodes.data();
+    uint32_t last = free_nodes_count - 1;
+
+    // the random stones end up at the back, the spare just before them
+    PlayerState<boardSize> fill = state;
+    for (uint32_t k = 0; k <= moves; ++k) {
+      using std::swap;
+
+      uint32_t kpos = distr(w.rng, distr_param(0, last - k));
+      swap(nodes[kpos], nodes[last - k]);
+      if (k < moves) {
+        fill[nodes[last - k].row] |= 1 << nodes[last - k].col;
+      }
+    }
+    Position spare = nodes[last - moves];
+
+    for (uint32_t p = 0; p < alive; ++p) {
+      Position pos = candidates[p];
+      PlayerState<boardSize> s = fill;
+      if (fill[pos.row] >> pos.col & 1) {
+        s[spare.row] |= 1 << spare.col;
+      } else {
+        s[pos.row] |= 1 << pos.col;
+      }
+      w.board.setState(s);
+      w.won[p] = w.board.isEndGame(0);
+    }
+  }
+
+  /*
+    Plays n fills shared by the candidates [0, alive), see _sharedFill,
+    shared out among the workers, or until `until` if timed. Adds the wins
+    of every candidate to wins and returns the number of fills played, each
+    of which is a playout of every candidate
+   */
+  uint32_t _sharedFills(const PlayerState<boardSize>& state,
+                        const Position* candidates, uint32_t free_nodes_count,
+                        uint32_t alive, uint32_t moves, uint32_t n,
+                        bool timed,
+                        std::chrono::steady_clock::time_point until,
+                        std::array<uint32_t, cellCount>& wins) {
+    uint32_t threads = _workers.size();
+    std::vector<uint32_t> played(threads, 0);
+
+    _parallel([&](Worker& w, uint32_t t) {
+      std::fill(w.wins.begin(), w.wins.begin() + alive, 0);
+      uint32_t block = timed ? _timedPlayouts
+                             : n / threads + (t < n % threads ? 1 : 0);
+      do {
+        for (uint32_t j = 0; j < block; ++j) {
+          _sharedFill(w, state, candidates, free_nodes_count, alive, moves);
+          for (uint32_t p = 0; p < alive; ++p) {
+            w.wins[p] += w.won[p];
+          }
         }
+        played[t] += block;
+      } while (timed && std::chrono::steady_clock::now() < until);
+    });
+
+    uint32_t fills = 0;
+    for (uint32_t t = 0; t < threads; ++t) {
+      fills += played[t];
+      for (uint32_t p = 0; p < alive; ++p) {
+        wins[p] += _workers[t].wins[p];
       }
+    }
+    return fills;
+  }
 
-      if (wins > max_wins) {
-        win_pos = pos;
-        max_wins = wins;
+  /*
+    Flat search without the early cutoff, for when the candidates do not
+    start even or share their fills: under time control every candidate
+    gets _timedPlayouts more playouts in turn until the clock runs out,
+    otherwise `iterations` more on top of what wins and visits hold. The
+    best share of wins is played
+   */
+  Position _flat(const PlayerState<boardSize>& state, Position* candidates,
+                 uint32_t free_nodes_count, uint32_t moves,
+                 uint32_t iterations,
+                 std::array<uint32_t, cellCount>& wins,
+                 std::array<uint32_t, cellCount>& visits) {
+    bool timed = _clock.enabled();
+    uint32_t n = timed ? _timedPlayouts : iterations;
+    uint32_t threads = _workers.size();
+
+    if (_crn) {
+      uint32_t fills = _sharedFills(state, candidates, free_nodes_count,
+                                    free_nodes_count, moves, iterations,
+                                    timed, _clock.split(1), wins);
+      for (uint32_t p = 0; p < free_nodes_count; ++p) {
+        visits[p] += fills;
       }
+    } else {
+      _parallel([&](Worker& w, uint32_t t) {
+        do {
+          for (uint32_t p = t; p < free_nodes_count; p += threads) {
+            if (timed && _clock.expired()) {
+              break;
+            }
+            for (uint32_t j = 0; j < n; ++j) {
+              if (_playout(w, state, candidates[p], w.freeNodes.data(),
+                           free_nodes_count, moves)) {
+                wins[p]++;
+              }
+            }
+            visits[p] += n;
+          }
+        } while (timed && !_clock.expired());
+      });
+    }
 
-    end_loop: {
+    uint32_t best = 0;
+    for (uint32_t p = 1; p < free_nodes_count; ++p) {
+      if (_better(wins[p], visits[p], wins[best], visits[best])) {
+        best = p;
       }
     }
+    return candidates[best];
+  }
 
-    auto end = std::chrono::steady_clock::now();
+  /*
+    Successive halving: the budget of the flat search, `iterations` per
+    candidate, is spent in rounds. Each round gives every remaining
+    candidate an equal share of budget / rounds and then drops the worse
+    half. Under time control each round gets an equal share of the time.
+   */
+  Position _halving(const PlayerState<boardSize>& state, Position* candidates,
+                    uint32_t free_nodes_count, uint32_t moves,
+                    uint32_t iterations,
+                    std::array<uint32_t, cellCount>& wins,
+                    std::array<uint32_t, cellCount>& visits) {
+    uint32_t threads = _workers.size();
+    uint32_t alive = free_nodes_count;
+    uint64_t budget = uint64_t(alive) * iterations;
+    uint32_t rounds = 0;
+    for (uint32_t n = alive; n > 1; n = (n + 1) / 2) {
+      rounds++;
+    }
 
-    auto diff = end - start;
-//    std::cout << "time:" << std::chrono::duration<double, std::milli>(diff).count() << std::endl;
+    for (uint32_t r = 0; r < rounds; ++r) {
+      if (_crn) {
+        uint32_t n = std::max<uint64_t>(budget / (uint64_t(alive) * rounds), 1);
+        uint32_t fills = _sharedFills(state, candidates, free_nodes_count,
+                                      alive, moves, n, _clock.enabled(),
+                                      _clock.split(double(r + 1) / rounds),
+                                      wins);
+        for (uint32_t p = 0; p < alive; ++p) {
+          visits[p] += fills;
+        }
+      } else if (_clock.enabled()) {
+        auto until = _clock.split(double(r + 1) / rounds);
+        _parallel([&](Worker& w, uint32_t t) {
+          do {
+            for (uint32_t p = t; p < alive && !_clock.expired();
+                 p += threads) {
+              for (uint32_t j = 0; j < _timedPlayouts; ++j) {
+                if (_playout(w, state, candidates[p], w.freeNodes.data(),
+                             free_nodes_count, moves)) {
+                  wins[p]++;
+                }
+              }
+              visits[p] += _timedPlayouts;
+            }
+          } while (std::chrono::steady_clock::now() < until);
+        });
+      } else {
+        uint32_t n = std::max<uint64_t>(budget / (uint64_t(alive) * rounds), 1);
+        _parallel([&](Worker& w, uint32_t t) {
+          for (uint32_t p = t; p < alive; p += threads) {
+            for (uint32_t j = 0; j < n; ++j) {
+              if (_playout(w, state, candidates[p], w.freeNodes.data(),
+                           free_nodes_count, moves)) {
+                wins[p]++;
+              }
+            }
+            visits[p] += n;
+          }
+        });
+      }
+      // move the better half to the front, keeping wins in step
+      for (uint32_t p = 1; p < alive; ++p) {
+        for (uint32_t q = p; q > 0 && _better(wins[q], visits[q],
+                                              wins[q - 1], visits[q - 1]); --q) {
+          std::swap(wins[q], wins[q - 1]);
+          std::swap(visits[q], visits[q - 1]);
+          std::swap(candidates[q], candidates[q - 1]);
+        }
+      }
+      alive = (alive + 1) / 2;
+    }
+    return candidates[0];
+  }
 
-    if (player)
-      return win_pos.col * boardSize + win_pos.row;
-    else
-      return win_pos.row * boardSize + win_pos.col;
+  /*
+    true if wins a out of visits va is a better share than wins b out of
+    vb, untried candidates come last
+   */
+  static bool _better(uint32_t a, uint32_t va, uint32_t b, uint32_t vb) noexcept {
+    return uint64_t(a) * vb > uint64_t(b) * va || (va && !vb);
   }
 
-private:
-  std::mt19937 _rng;
+  static const uint32_t _timedPlayouts = 32; // between two looks at the clock
+  MoveClock _clock;
+  TranspositionTable _tt;
+  OpeningBook _book;
+  bool _prune = false; // fill in dead and captured cells, see inferior.h
+  bool _crn = false; // fills shared by the candidates, see _sharedFill
+  uint32_t _pruned = 0; // cells filled in for the last move
+  // the position of the last ponder() and its statistics, entry
+  // candidate * cellCount + reply
+  uint32_t _ponderCount = 0;
+  std::array<uint16_t, cellCount> _ponderIds;
+  std::array<Position, cellCount> _ponderNodes;
+  std::vector<uint32_t> _ponderWins;
+  std::vector<uint32_t> _ponderVisits;
+  std::vector<Worker> _workers; // at least one, see setThreads
+  std::unique_ptr<WorkerPool> _pool; // for the workers after the first
+  Search _search = Search::Flat;
 };
 
 
@@ -470,6 +1176,13 @@ public:
   explicit Player(uint32_t player_id, Board& b) : _id(player_id), _board(b) {}
 
 	virtual void set_trials(uint32_t trials) {};
+	virtual void set_search(Search search) {};
+	virtual void set_clock(const MoveClock& clock) {};
+	virtual void ponder(const std::atomic<bool>& stop) {};
+	virtual void set_tt(size_t megabytes) {};
+	virtual bool set_book(const char* path) { return false; };
+	virtual void set_prune(bool prune) {};
+	virtual uint32_t get_pruned() { return 0; };
 
   virtual uint32_t askMove() {
     char colc;
@@ -484,7 +1197,8 @@ public:
       col = colc - 'A';
       row = rowc - 1;
 
-      if (col >= 0 && col < Board::size && row >= 0 && row < Board::size)
+      if (col >= 0 && col < int32_t(Board::size) && row >= 0 &&
+          row < int32_t(Board::size))
         return (row * Board::size + col);
       else
         std::cout << "Invalid position\n";
@@ -524,6 +1238,34 @@ public:
 		_trials = trials;
 	}
 
+	void set_search(Search search) {
+		_ai.setSearch(search);
+	}
+
+	void set_clock(const MoveClock& clock) {
+		_ai.setClock(clock);
+	}
+
+	void ponder(const std::atomic<bool>& stop) {
+		_ai.ponder(Player<Board>::_board, Player<Board>::_id, stop);
+	}
+
+	void set_tt(size_t megabytes) {
+		_ai.setTableSize(megabytes);
+	}
+
+	bool set_book(const char* path) {
+		return _ai.setBook(path);
+	}
+
+	void set_prune(bool prune) {
+		_ai.setPrune(prune);
+	}
+
+	uint32_t get_pruned() {
+		return _ai.getPruned();
+	}
+
   virtual uint32_t askMove() {
     return _ai.getNextMove(Player<Board>::_board, Player<Board>::_id, _trials);
   }
@@ -533,11 +1275,194 @@ protected:
   uint32_t _trials;
 };
 
+/*
+  Board sizes the engine is compiled for, see createSized
+ */
+static const uint32_t minSize = 3;
+static const uint32_t maxSize = 16;
+
+/*
+  Makes a T<Size> for the size given at run time: a table holds a maker
+  for every size from minSize to maxSize, filled once by the recursion of
+  SizeMakers, so every size keeps the kernels compiled for it. Returns
+  nullptr for other sizes
+ */
+template<class Base, template<int> class T, int Size = maxSize>
+struct SizeMakers {
+  static Base* make(uint32_t seed) {
+    return new T<Size>(seed);
+  }
+
+  static void fill(Base* (**table)(uint32_t)) {
+    table[Size - minSize] = &make;
+    SizeMakers<Base, T, Size - 1>::fill(table);
+  }
+};
+
+template<class Base, template<int> class T>
+struct SizeMakers<Base, T, minSize - 1> {
+  static void fill(Base* (**)(uint32_t)) {}
+};
+
+template<class Base, template<int> class T>
+Base* createSized(uint32_t size, uint32_t seed) {
+  static Base* (*table[maxSize - minSize + 1])(uint32_t);
+  static bool filled = (SizeMakers<Base, T>::fill(table), true);
+  (void)filled;
+  if (size < minSize || size > maxSize) {
+    return nullptr;
+  }
+  return table[size - minSize](seed);
+}
+
+// the Engine interface of engine.h with the settings of a hex engine of
+// any size, HexEngine<Size> below is the one for a given board size
+class HexEngineBase : public Engine {
+public:
+	virtual void set_search(Search search) = 0;
+	virtual void set_threads(uint32_t threads) = 0;
+	virtual void set_tt(size_t megabytes) = 0;
+	virtual bool set_book(const char* path) = 0;
+	virtual void set_prune(bool prune) = 0;
+	virtual void set_crn(bool crn) = 0;
+	virtual void set_clock(const MoveClock& clock) = 0;
+	// nullptr unless minSize <= side <= maxSize
+	static HexEngineBase* create(uint32_t side, uint32_t seed);
+};
+
+// the Engine interface on top of a GameBoard and its MonteCarloAI, used by
+// the protocol of autoplay and by match.cpp
+template<int Size>
+class HexEngine : public HexEngineBase {
+public:
+	typedef GameBoard<Size> gameBoardType;
+
+	HexEngine(uint32_t seed) : _ai(seed) {}
+
+	void set_search(Search search) {
+		_ai.setSearch(search);
+	}
+
+	// 0 means one per hardware core
+	void set_threads(uint32_t threads) {
+		_ai.setThreads(threads);
+	}
+
+	// time=... and clock=... as a MoveClock, after set_budget()
+	void set_clock(const MoveClock& clock) {
+		_clock = clock;
+		_ai.setClock(_clock);
+	}
+
+	void set_tt(size_t megabytes) {
+		_ai.setTableSize(megabytes);
+	}
+
+	bool set_book(const char* path) {
+		return _ai.setBook(path);
+	}
+
+	void set_prune(bool prune) {
+		_ai.setPrune(prune);
+	}
+
+	void set_crn(bool crn) {
+		_ai.setCrn(crn);
+	}
+
+	const char* name() const {
+		return "hex by Boris Kaul adapted by AK";
+	}
+
+	void set_budget(size_t iterations, double move_ms = 0,
+			double game_ms = 0) {
+		_trials = iterations;
+		_clock.set_move_time(move_ms);
+		_clock.set_game_time(game_ms);
+		_ai.setClock(_clock);
+	}
+
+	void new_game() {
+		_board.reset();
+		_player = 0;
+		_winner = ' ';
+		_clock.new_game();
+		_ai.setClock(_clock);
+	}
+
+	bool apply_move(size_t tile) {
+		if(tile >= Size * Size || !_board.toggle(tile, _player)) {
+			return false;
+		}
+		if(_board.isEndGame(_player)) {
+			_winner = _player? 'O': 'X';
+		}
+		_player ^= 1;
+		return true;
+	}
+
+	void think() {
+		_best = _ai.getNextMove(_board, _player, _trials);
+	}
+
+	size_t best_move() const {
+		return _best;
+	}
+
+	// the player who moved last thinks about the replies to his move
+	void ponder(const std::atomic<bool>& stop) {
+		_ai.ponder(_board, _player ^ 1, stop);
+	}
+
+	char get_winner() const {
+		return _winner;
+	}
+
+	size_t get_pruned() const {
+		return _ai.getPruned();
+	}
+
+private:
+	gameBoardType _board;
+	MonteCarloAI<gameBoardType> _ai;
+	MoveClock _clock;
+	uint32_t _trials = 1000;
+	uint32_t _player = 0; // to move, 0 = X
+	size_t _best = 0;
+	char _winner = ' ';
+};
+
+HexEngineBase* HexEngineBase::create(uint32_t side, uint32_t seed) {
+	return createSized<HexEngineBase, HexEngine>(side, seed);
+}
+
+/*
+  Game of any size, Game<Size> below is the one for a given board size
+ */
+class GameBase {
+public:
+  virtual ~GameBase() {}
+
+  virtual void run() = 0;
+
+	virtual int autoplay(char color, unsigned short board_side = 11,
+						size_t iter = 1000, Search search = Search::Flat,
+						const MoveClock& clock = MoveClock(),
+						bool ponder = false, size_t tt_mb = 0,
+						const char* book = nullptr, bool prune = false,
+						uint32_t threads = 1, bool crn = false) = 0;
+
+  /*
+    nullptr unless minSize <= size <= maxSize
+   */
+  static GameBase* create(uint32_t size, uint32_t seed);
+};
+
 /*
   Main Game Object
  */
 template<int Size>
-class Game {
+class Game : public GameBase {
 public:
   typedef GameBoard<Size> gameBoardType;
   typedef MonteCarloAI<gameBoardType> aiType;
@@ -626,131 +1551,25 @@ public:
     }
   }
 
-	int autoplay(char color, unsigned short board_side = 11,
-						size_t iter = 1000) {
-		uint32_t second = (color == 'O'? 1: 0);
-		uint32_t first = second ^ 1;
-		_reset();
-		_players[first].reset(new playerType(first, _board));
-		_players[second].reset(new botType(second, _board, 2, 0));
-		_players[second]->set_trials(iter);
-		_state = State::Game;
-		char column; // letter representing board column from a-z
-		unsigned short col; // numeric column
-		unsigned short row; // numeric row
-		char c; // used for input processing
-		size_t move; // result of calling askMove()
-		// send handshake message color: name of program by author
-		// this string should uniquely identify the player
-		cout << color << ": hex by Boris Kaul adapted by AK\n" << flush;
-		if(color == 'X') {
-			// wait for other player's handshake message
-			cin >> c; // should be the other player's color
-			if(c != 'O') {
-				cout << "X. E: expecting handshake message "
-					"from O\n" << flush;
-				return -2;
-			}
-			cin >> c; // should be ':'
-			if(c != ':') {
-				cout << "X. E: expecting : after O in "
-					"handshake message\n" << flush;
-				return -3;
-			}
-			// ignore the rest of the line
-			cin.clear();
-			cin.ignore(numeric_limits<streamsize>::max(), '\n');
-			// start the timer
-			auto start = std::chrono::steady_clock::now();
-			// make a move
-			move = _players[_currentPlayer]->askMove();
-			_board.toggle(move, _currentPlayer);
-			// stop the timer
-			auto end = std::chrono::steady_clock::now();
-			int tmilli = std::chrono::duration<double, std::milli>
-				(end - start).count();
-			cout << color << char((move % board_side) + 'a') <<
-				(move / board_side + 1) << " #1 t=" <<
-				tmilli << "ms\n" << flush;
-			_currentPlayer ^= 1;
-			_turn += 1;
-		}
-		int counter = 1; // count the moves
-		while(true) {
-			cin >> c; // other player color
-			cin >> column; // lower case letter represenging
-					// board column
-			if(c != (color=='O'? 'X': 'O') || column == ':') {
-				cin.clear();
-				cin.ignore(numeric_limits<streamsize>::max(),
-					'\n');
-				continue;
-			}
-			if(column == '.') { // the other player quits, game over
-				break;
-			}
-			col = column - 'a';
-			if(col >= board_side) {
-				cout << color <<  ". E: " << color <<
-				" received illegal column: '" << c << "'\n";
-				return -4;
-			}
-			cin >> row;
-			if(row > board_side) {
-				cout << color << ". E: " << color <<
-				" received illegal row: '" << row << "'\n";
-				return -5;
-			}
-			c = cin.peek();
-			if(c == '.') { // dot at the end of the other player's
-				// move means that he wins,
-				// or maybe he gives up - game over
-				break;
-			}
-			cin.clear();
-			cin.ignore(numeric_limits<streamsize>::max(), '\n');
-			// start the timer
-			auto start = std::chrono::steady_clock::now();
-			// register the opponent's move
-			move = (row - 1) * board_side + col;
-			if(_board.isToggled(move)) {
-				cout << color << ". E: received illegal "
-					<< "move " << column << row << '\n';
-				return -6;
-			}
-			_board.toggle(move, _currentPlayer);
-			// check if game is over
-			if(_board.isEndGame(_currentPlayer)) {
-				break;
-			}
-			_currentPlayer ^= 1;
-			_turn += 1;
-			if(color == 'X') {
-				++counter;
-			}
-			// make a move. If I won, add a dot.
-			move = _players[_currentPlayer]->askMove();
-			_board.toggle(move, _currentPlayer);
-			bool over = _board.isEndGame(_currentPlayer);
-			// stop the timer
-			auto end = std::chrono::steady_clock::now();
-			int tmilli = std::chrono::duration<double, std::milli>
-				(end - start).count();
-			cout << color << char((move % board_side) + 'a') <<
-				(move / board_side + 1) << (over? '.': ' ') <<
-				'#' << counter << " t=" << tmilli <<
-				"ms\n" << flush;
-			if(over) {
-				break;
-			}
-			_currentPlayer ^= 1;
-			_turn += 1;
-			if(color == 'O') {
-				++counter;
-			}
+	int autoplay(char color, unsigned short board_side, size_t iter,
+						Search search, const MoveClock& clock, bool ponder,
+						size_t tt_mb, const char* book, bool prune,
+						uint32_t threads, bool crn) {
+		HexEngine<Size> engine(0);
+		engine.set_budget(iter);
+		engine.set_search(search);
+		engine.set_threads(threads);
+		engine.set_tt(tt_mb);
+		engine.set_prune(prune);
+		engine.set_crn(crn);
+		if(book && !engine.set_book(book)) {
+			cerr << "E: " << book << " is not a book for side " <<
+				board_side << '\n';
+			return -1;
 		}
-		return 0;
-
+		engine.set_clock(clock);
+		_state = State::Game;
+		return play_protocol(engine, color, board_side, ponder, prune);
 	}
 
   State getState() const noexcept { return _state; }
@@ -776,17 +1595,86 @@ private:
   std::unique_ptr<playerType> _players[2];
 };
 
+GameBase* GameBase::create(uint32_t size, uint32_t seed) {
+  return createSized<GameBase, Game>(size, seed);
+}
+
+// usage: <program name> (X|O) [<board side>] [<iterations>] [<threads>]
+// threads = 0 uses one thread per hardware core
+// options of the form name=value may be given anywhere after the program name:
+// search=flat|halving   how iterations are shared among candidates
+// time=<ms>   think for ms per move instead of counting iterations
+// clock=<ms>   think for ms for the whole game, spread over the moves
+// ponder=on|off   think on the opponent's time
+// tt=<megabytes>   size of the transposition table, 0 (default) = none
+// book=<file>   play the moves of an opening book made by bookgen
+// prune=on|off   leave out dead and captured cells, reported as p=<n>
+// crn=on|off   share every random fill among the candidates
+#ifndef HEX_NO_MAIN // match.cpp includes this file for the HexEngine
 int main(int argc, char* argv[]) {
   std::random_device rd;
 
-  auto g = Game<11>(rd());
-
 	char color = 'X'; // can be X or O
 	unsigned short board_side = 11; // side of the board minimum 3
 	size_t iter = 1000; // number of iterations should be selectable
+	uint32_t threads = 1; // number of search threads
+	Search search = Search::Flat; // search=... option
+	MoveClock clock; // time=... and clock=... options
+	bool ponder = false; // ponder=... option
+	size_t tt_mb = 0; // tt=... option
+	string book; // book=... option
+	bool prune = false; // prune=... option
+	bool crn = false; // crn=... option
+	// take out the name=value options, leaving the positional parameters
+	int nargs = 1;
+	for(int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		size_t eq = arg.find('=');
+		if(eq == string::npos) {
+			argv[nargs++] = argv[i];
+			continue;
+		}
+		string name = arg.substr(0, eq), value = arg.substr(eq + 1);
+		if(name == "search" && value == "flat") {
+			search = Search::Flat;
+		} else if(name == "search" && value == "halving") {
+			search = Search::Halving;
+		} else if(name == "ponder" && (value == "on" || value == "off")) {
+			ponder = value == "on";
+		} else if(name == "tt") {
+			stringstream ss(value);
+			ss >> tt_mb;
+		} else if(name == "book") {
+			book = value;
+		} else if(name == "prune" && (value == "on" || value == "off")) {
+			prune = value == "on";
+		} else if(name == "crn" && (value == "on" || value == "off")) {
+			crn = value == "on";
+		} else if(name == "time") {
+			stringstream ss(value);
+			double ms = 0;
+			ss >> ms;
+			clock.set_move_time(ms);
+		} else if(name == "clock") {
+			stringstream ss(value);
+			double ms = 0;
+			ss >> ms;
+			clock.set_game_time(ms);
+		} else {
+			cerr << "E: unknown option " << arg << '\n';
+			return -1;
+		}
+	}
+	argc = nargs;
 	// parse command line parameters
-	argc = argc > 4? 4: argc; // forward compatibility measure
+	argc = argc > 5? 5: argc; // forward compatibility measure
 	switch(argc) {
+	case 5:
+	{
+		stringstream ss;
+		ss << argv[4];
+		ss >> threads;
+	}
 	case 4:
 	{
 		stringstream ss; // used for reading numbers from strings
@@ -806,17 +1694,23 @@ int main(int argc, char* argv[]) {
 			cerr << "E: first argument must be X or O\n";
 			return -1; // there is some error
 		}
-		if(board_side != 11) {
-			cerr << "E: " << color <<
-				" can only play on an 11x11 board\n";
+		if(board_side > maxSize) {
+			cerr << "E: " << color << " can only play on boards up to " <<
+				maxSize << 'x' << maxSize << '\n';
 			return -100;
 		}
-		g.autoplay(color, board_side, iter);
-		return 0;
+		{
+			unique_ptr<GameBase> g(GameBase::create(board_side, rd()));
+			return g->autoplay(color, board_side, iter, search, clock,
+				ponder, tt_mb, book.empty()? nullptr: book.c_str(), prune,
+				threads, crn);
+		}
 	case 1: ; // no command line arguments - continue with interactive play
 	}
 
+  auto g = Game<11>(rd());
   g.run();
 
   return 0;
 }
+#endif
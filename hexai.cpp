@@ -1,6 +1,10 @@
 // tested with gcc 4.8.0, AMD Phenom II X6 1090T,
-// to compile: g++ -O3 -std=c++0x -o hexai hexai.cpp
+// to compile: g++ -O3 -std=c++0x -pthread -o hexai hexai.cpp
 // above compiler flags give about .5 seconds per AI move on a 11x11 board.
+// The search can be spread over several threads, see
+// SizedBoard::set_threads(). The engine is compiled for every board side
+// from 3 to MAX_SIDE, see Board::create().
+// Build with -march=native (or -mavx2) to check 16 (8) playouts at once.
 // Total rewrite with Monte-Carlo ai, not reusing code from previous homework.
 // This code relies on <cstdint> for uint32_t type, for bitwise scan altorithm.
 // Black and white stones, black moves first, black sides are North and South
@@ -35,63 +39,393 @@
 #include <chrono>
 #include <cstdint> // uint32_t
 #include <sstream> // reading integer from string
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory> // unique_ptr
+#include <array>
+#include <type_traits> // conditional, integral_constant
+#include <cstdlib> // malloc, free for the allocation counter
+#include <cstring> // memcpy
+#include <cmath> // sqrt
+#include "floodfill.h" // whole-board connectivity for sides up to 11
+#include "unionfind.h" // incremental winner detection
+#include "mcts.h" // search tree of search=mcts
+#include "timecontrol.h" // time=... and clock=... options
+#include "transposition.h" // zobrist hashing, tt=... option
+#include "book.h" // book=... option
+#include "inferior.h" // dead and captured cells, prune=... option
+#include "solver.h" // exact endgame search, solve=... option
+#include "widerow.h" // rows of boards above 32x32
+#include "engine.h" // the interface seen by match.cpp and the protocol
+#include "workerpool.h" // search threads kept between moves
 using namespace std;
 
-// Board does the Monte-Carlo simulations, its field is optimized for
+#ifdef COUNT_ALLOCS
+// compile with -DCOUNT_ALLOCS to count the heap allocations made by each
+// thread; every search then checks that it did not allocate, and reports
+// an error on cerr and aborts if it did
+thread_local size_t alloc_count = 0;
+void *operator new(size_t n) {
+	++alloc_count;
+	if(void *p = malloc(n? n: 1)) {
+		return p;
+	}
+	throw bad_alloc();
+}
+void operator delete(void *p) noexcept {
+	free(p);
+}
+#endif
+
+// StoneArray keeps every tile of the board in a fixed-size permutation array,
+// together with its inverse: slot[t] is the index of tile t in stone. This
+// way a tile can be found and moved to another slot in O(1), similar to the
+// _freeNodesIndex of hex.cpp's GameBoard. Capacity is the number of tiles.
+template<size_t Capacity>
+struct StoneArray {
+	typedef int *iterator;
+	array<int, Capacity> stone; // the tiles
+	array<int, Capacity> slot; // slot[tile] = index of tile in stone
+	void reset(size_t size) {
+		for(size_t i = 0; i < size; i++) {
+			stone[i] = i;
+			slot[i] = i;
+		}
+	}
+	// copies the first size slots of another array, used by the workers
+	void copy(const StoneArray &o, size_t size) {
+		copy_n(o.stone.begin(), size, stone.begin());
+		copy_n(o.slot.begin(), size, slot.begin());
+	}
+	iterator begin() {
+		return stone.data();
+	}
+	// where is the tile now?
+	iterator find(int tile) {
+		return begin() + slot[tile];
+	}
+	// exchanges the tiles in two slots
+	void swap(iterator a, iterator b) {
+		std::swap(*a, *b);
+		slot[*a] = a - begin();
+		slot[*b] = b - begin();
+	}
+	// moves tile to slot it, the tile that was there takes its old place
+	void put(int tile, iterator it) {
+		swap(find(tile), it);
+	}
+	// shuffles the slots [first, last) without updating the index, which
+	// would double the cost of every playout. reindex() must be called
+	// on the same range before find() or put() are used again
+	template<class Engine>
+	void shuffle(iterator first, iterator last, Engine &rng) {
+		std::shuffle(first, last, rng);
+	}
+	void reindex(iterator first, iterator last) {
+		for(auto it = first; it != last; ++it) {
+			slot[*it] = it - begin();
+		}
+	}
+};
+
+// Random engines for the playouts. They only need to be fast and have good
+// low and high bits, both are standard UniformRandomBitGenerators so any
+// engine of <random> (e.g. mt19937_64) can be used instead.
+// SplitMix64 by Sebastiano Vigna, also used to seed Xoshiro256ss.
+class SplitMix64 {
+	uint64_t x{0};
+public:
+	typedef uint64_t result_type;
+	static constexpr uint64_t min() { return 0; }
+	static constexpr uint64_t max() { return ~uint64_t(0); }
+	void seed(uint64_t s) {
+		x = s;
+	}
+	uint64_t operator()() {
+		uint64_t z = (x += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+};
+
+// xoshiro256** by David Blackman and Sebastiano Vigna
+class Xoshiro256ss {
+	uint64_t s[4];
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+public:
+	typedef uint64_t result_type;
+	static constexpr uint64_t min() { return 0; }
+	static constexpr uint64_t max() { return ~uint64_t(0); }
+	Xoshiro256ss() {
+		seed(0);
+	}
+	void seed(uint64_t seed) {
+		SplitMix64 sm;
+		sm.seed(seed);
+		for(auto &x : s) {
+			x = sm();
+		}
+	}
+	uint64_t operator()() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+};
+
+// engine used by the playouts, choose another one at compile time with
+// e.g. -DPLAYOUT_RNG=SplitMix64 or -DPLAYOUT_RNG=mt19937_64
+#ifndef PLAYOUT_RNG
+#define PLAYOUT_RNG Xoshiro256ss
+#endif
+typedef PLAYOUT_RNG PlayoutRng;
+
+// The Monte-Carlo loop checks the random fills of several playouts at once,
+// one playout in each lane of a SIMD register. A batch is stored as an array
+// of uint32_t where word c * PLAYOUT_LANES + i is column c of the i-th fill.
+// GCC's vector extensions are used so the compiler picks the instructions of
+// the target (-mavx512f, -mavx2 or plain SSE2). -DSCALAR_PLAYOUTS turns a
+// lane vector into a single uint32_t and checks one fill at a time with
+// exactly the same code.
+#ifdef SCALAR_PLAYOUTS
+#define PLAYOUT_LANES 1
+typedef uint32_t LaneVec;
+#else
+#if defined(__AVX512F__)
+#define PLAYOUT_LANES 16
+#elif defined(__AVX2__)
+#define PLAYOUT_LANES 8
+#else
+#define PLAYOUT_LANES 4
+#endif
+typedef uint32_t LaneVec __attribute__((vector_size(4 * PLAYOUT_LANES)));
+inline bool none(LaneVec v) {
+	uint32_t x = 0;
+	for(int i = 0; i < PLAYOUT_LANES; ++i) {
+		x |= v[i];
+	}
+	return !x;
+}
+#endif
+inline bool none(uint32_t v) {
+	return !v;
+}
+
+// spreads the stones b along those runs of stones in row r that contain
+// them, in both directions. Kogge-Stone style fill: 5 fixed shift/or steps
+// per direction cover all 32 bits, so unlike the while-loops of
+// SizedBoard::is_connected there is nothing that depends on the data and all
+// lanes of a vector always do the same work
+template<class V>
+inline V spread_row(V b, V r) {
+	V p = r; // tiles the spread may still go through
+	b |= p & (b << 1);
+	p &= p << 1;
+	b |= p & (b << 2);
+	p &= p << 2;
+	b |= p & (b << 4);
+	p &= p << 4;
+	b |= p & (b << 8);
+	p &= p << 8;
+	b |= p & (b << 16);
+	p = r;
+	b |= p & (b >> 1);
+	p &= p >> 1;
+	b |= p & (b >> 2);
+	p &= p >> 2;
+	b |= p & (b >> 4);
+	p &= p >> 4;
+	b |= p & (b >> 8);
+	p &= p >> 8;
+	b |= p & (b >> 16);
+	return b;
+}
+
+// the same row by row scan as SizedBoard::is_connected on every lane of a
+// batch at once. Sets connected[i] to the stones of the last row that are
+// connected to the first one in the i-th fill, so it is non-zero if and only
+// if that fill is connected. memcpy does the (unaligned) vector loads. The
+// side is a template parameter so that the loop has a fixed trip count
+template<int Side>
+void connected_lanes(const uint32_t *batch, uint32_t *connected) {
+	LaneVec a, r;
+	memcpy(&a, batch, sizeof(a));
+	for(int i = 1; i < Side; ++i) {
+		memcpy(&r, batch + i * PLAYOUT_LANES, sizeof(r));
+		a = spread_row((a | (a >> 1)) & r, r);
+		if(none(a)) {
+			break; // no lane can connect any more
+		}
+	}
+	memcpy(connected, &a, sizeof(a));
+}
+
+// Board is what the rest of the program sees of an engine: a new game, the
+// options and the moves. The engine itself is SizedBoard, which is compiled
+// once for every side from 3 to MAX_SIDE so that the side is a constant in
+// all its loops, and create() picks the one for a side at run time. Boards
+// up to 32x32 keep a row in a uint32_t, larger ones in a WideRow of
+// widerow.h, so MAX_SIDE can be raised at compile time for research on
+// large boards, e.g. -DMAX_SIDE=128, at the cost of a longer build.
+#ifndef MAX_SIDE
+#define MAX_SIDE 64
+#endif
+static_assert(MAX_SIDE >= 3 && MAX_SIDE <= 255, "sides are unsigned char");
+
+class Board : public Engine {
+public:
+	// how the playouts of a move are shared among the candidates:
+	// flat = nshuffles for every candidate, halving = the same total
+	// spent by successive halving, see search_halving(), mcts = the same
+	// total spent by a UCT tree search, see search_mcts()
+	enum Search { flat, halving, mcts };
+	virtual ~Board() {}
+	// a new engine for a board of the given side, which is clamped to
+	// 3 .. MAX_SIDE. The programs reject larger sides before they get here
+	static Board *create(unsigned side, bool aiblack = 1,
+		bool aiwhite = 1);
+	virtual void reset(bool aiblack = 1, bool aiwhite = 1) = 0;
+	virtual void set_search(Search s) = 0;
+	virtual void set_tree_nodes(size_t n) = 0;
+	virtual void set_ponder(bool on) = 0;
+	virtual void set_amaf(bool on, double k) = 0;
+	virtual void set_tt(size_t megabytes) = 0;
+	virtual void set_prune(bool on) = 0;
+	virtual void set_solver(size_t cells, size_t nodes) = 0;
+	virtual bool set_book(const char *path) = 0;
+	virtual uint64_t position_key(bool &turned) const = 0;
+	virtual int play_move(size_t t) = 0;
+	virtual void set_clock(double move_ms, double game_ms) = 0;
+	virtual void set_iterations(size_t n) = 0;
+	virtual void set_threads(size_t n) = 0;
+	virtual void set_seed(unsigned seed) = 0;
+	virtual unsigned char get_side() = 0;
+	virtual void print_stones() = 0;
+	virtual void print() = 0;
+	virtual size_t make_move() = 0;
+	virtual void bench_playouts(size_t n) = 0;
+	virtual int try_move(unsigned char row, unsigned char col) = 0;
+	virtual void play() = 0;
+	virtual int autoplay(char color, unsigned short board_side = 11,
+		size_t iter = 1000, size_t threads = 1) = 0;
+};
+
+// SizedBoard does the Monte-Carlo simulations, its field is optimized for
 // quick determining of the winner.
-class Board {
-	unsigned char side; // side of the board defines its size
-	size_t size; // always = side * side
-	vector<int> stone; // all the stones, all whites on top,
+template<int Side>
+class SizedBoard : public Board {
+	static const int side = Side; // side of the board defines its size
+	static const size_t size = Side * Side;
+	typedef StoneArray<Side * Side> Stones;
+	// a row or column of stones, see widerow.h
+	typedef typename conditional<(Side <= 32), uint32_t,
+		WideRow<(Side + 63) / 64>>::type Row;
+	typedef array<Row, Side> Lines; // a bitmap of one color
+	typedef integral_constant<bool, (Side <= 32)> Narrow; // rows fit the
+		// lanes of connected_lanes and the solver
+	Stones stone; // all the stones, all whites on top,
 		// those stones that are on the board are on top and bottom of
 		// this array, pointers cur0 and cur1 separate the stones on
 		// the board from stones off the board (which still are used
 		// for Monte-Carlo simulation, but not shown on the board)
-	vector<int>::iterator cur0, cur1, middle; // iterators pointing to first
+	typename Stones::iterator cur0, cur1, middle; // iterators pointing to first
 		// one, one after last, and first black stone (aka middle)
 		// stones that are not on the board = those
 		// that are shuffled during Monte-Carlo tests
-	vector<uint32_t> blackrow, whitecol; // bitmaps storing the stones as
+	Lines blackrow, whitecol; // bitmaps storing the stones as
 		// single bits in a row: each row is 32-
 	char winner; // ' '=game is running, 'X' or 'O' means game is over
+	WinTracker links; // connected groups of stones, knows the winner
+	uint64_t hash; // zobrist hash of the stones on the board
+	uint64_t rhash; // the same for the board turned by 180 degrees
 	bool whites_move; // whose move is it now? 1 if whites
 	bool black_ai; // is black player played by AI?
 	bool white_ai; // is white player played by AI?
-	bool init_success; // initialization successful flag
+	bool init_success{false}; // initialization successful flag
 	default_random_engine *randengine; // used for shuffle
 	size_t nshuffles{1000}; // number of shuffles to perform
+	Search search{flat};
+	SearchTree tree; // tree of the mcts search, kept between moves
+	size_t tree_nodes{1 << 20}; // nodes in each arena of the tree
+	vector<size_t> path; // tree nodes from the root to the current leaf
+	vector<uint64_t> path_hash; // hashes of the positions of path
+	TranspositionTable tt; // statistics of positions seen in this game
+	OpeningBook book; // moves played without a search, see book.h
+	vector<uint16_t> children; // moves of a leaf that is being expanded
+	MoveClock clock; // time control, nshuffles is used while it is off
+	bool pondering{false}; // think on the opponent's time in autoplay
+	static const size_t timed_playouts = 4 * PLAYOUT_LANES; // playouts
+		// per candidate between two looks at the clock
+	// each search thread fills its own bitmaps with its own random engine,
+	// so workers never touch each other's data
+	struct Worker {
+		Lines empty; // private copy of emptycol
+		Lines base; // white stones every fill starts from
+		Lines wcol; // scratch bitmap reused by every playout
+		array<Row, Side * PLAYOUT_LANES> batch; // PLAYOUT_LANES
+			// fills, see connected_lanes
+		vector<uint32_t> amaf_wins; // see credit_amaf, merged into
+		vector<uint32_t> amaf_visits; // the Board's after every round
+		PlayoutRng rng; // private random stream
+	};
+	vector<Worker> workers; // one per thread of the pool
+	unique_ptr<WorkerPool> pool; // threads running the search
+	vector<size_t> moves; // candidate moves of the current search
+	size_t best{0}; // move found by the last think()
+	vector<size_t> empties; // empty tiles of the current search, a
+		// superset of moves, random_fill draws from them
+	bool symmetric{false}; // the position is its own 180 degree turn,
+		// so only one tile of each mirrored pair is a candidate
+	bool prune{false}; // fill in dead and captured tiles, see inferior.h
+	size_t pruned{0}; // tiles filled in before the last search
+	vector<char> cells; // the board for fill_inferior
+	EndgameSolver solver; // exact search of the last few tiles
+	size_t solve_cells{0}; // solve positions with at most this many
+		// empty tiles, 0 = never
+	Lines basecol; // white stones every playout starts from:
+		// whitecol plus the tiles filled in for white
+	size_t white_left; // white stones the playouts add, the candidate
+		// included if white is to move
+	Lines emptycol; // empty tiles of the current search, laid
+		// out like whitecol
+	vector<int> tile; // win count for each candidate tile
+	vector<size_t> visits; // playouts done for each candidate tile
+	bool amaf{false}; // blend all-moves-as-first values into the ranking
+	double rave{1000}; // playouts at which direct and amaf weigh the same
+		// (roughly), see value()
+	vector<size_t> amaf_wins; // wins of the player to move over all the
+		// playouts in which the tile ended up his, whatever the candidate
+	vector<size_t> amaf_visits; // number of those playouts
+	size_t round_moves; // candidates in the current round of playouts
+	size_t round_playouts; // playouts per candidate in this round
+	atomic<size_t> next_move; // index of next candidate to be evaluated
+	atomic<size_t> search_allocs; // allocations counted during a search
 public:
-	Board(unsigned char side, bool aiblack = 1, bool aiwhite = 1) {
-		reset(side, aiblack, aiwhite);
-	}
-	Board() : init_success(false) {}; // we allow uninitialized board to be
-		// created,
-		// in case the class user wants to specify the board size at
-		// a later time, which is done using reset() function
-	~Board() {}
-	// full reset used for starting a new game, makes sure that the side of
-	// the board is at least 3
-	void reset(unsigned char side, bool aiblack = 1, bool aiwhite = 1) {
+	SizedBoard(bool aiblack = 1, bool aiwhite = 1) {
+		reset(aiblack, aiwhite);
+	}
+	// full reset used for starting a new game
+	void reset(bool aiblack = 1, bool aiwhite = 1) {
 		if(!init_success) { // seed only once
 			unsigned seed = chrono::system_clock::now()
 				.time_since_epoch().count();
 			randengine = new default_random_engine(seed);
 		}
-		if(side < 3) {
-			side = 3;
-		}
-		if(side > 32) {
-			side = 32;
-		}
-		this->side = side; // side of the board won't change during game
-		size = side * side; // number of tiles is set only once here
-		stone.resize(size); // resize this vector without initializing
-		// initialize the stone vector:
-		for(int i = 0; i < size; i++) {
-			stone[i] = i;
-		}
+		stone.reset(size); // initialize the stone array
 		cur0 = stone.begin();
-		cur1 = stone.end();
+		cur1 = stone.begin() + size;
 		middle = cur0 + (size / 2); // black stones start here
 		// each of our stones will always be assigned to a unique tile
 		// no matter if the stone is  on the board or not.
@@ -100,15 +434,139 @@ public:
 		// depends on its position in the stone array. Top half will
 		// be white, bottom half - black. If the board side is odd
 		// then the number of black stones is 1 more than white ones
-		blackrow.clear();
-		blackrow.resize(side); // initialize to zero the blackrow vector
-		whitecol.clear();
-		whitecol.resize(side);
+		blackrow.fill(0);
+		whitecol.fill(0);
+		links.reset(side);
+		hash = 0;
+		rhash = 0;
 		winner = ' '; // game is running
 		whites_move = false; // black starts
 		black_ai = aiblack; // is black to be played by computer?
 		white_ai = aiwhite; // is white to be played by computer (too)?
+		tile.resize(size);
+		visits.resize(size);
+		amaf_wins.resize(size);
+		amaf_visits.resize(size);
+		moves.reserve(size);
+		empties.reserve(size);
+		cells.resize(size);
+		path.reserve(size + 1);
+		path_hash.reserve(size + 1);
+		children.reserve(size);
+		tree.reset(tree.capacity()); // new game, nothing to reuse
+		clock.new_game();
 		init_success = true; // init done, allow calling other functions
+		if(!pool) {
+			set_threads(1);
+		}
+	}
+	// the mcts arenas are allocated here, once for the whole game
+	void set_search(Search s) {
+		search = s;
+		if(search == mcts || pondering) {
+			tree.reset(tree_nodes);
+		}
+	}
+	// sets the number of nodes of each of the two arenas of the mcts tree
+	void set_tree_nodes(size_t n) {
+		tree_nodes = n < 1? 1: n;
+		if(search == mcts || pondering) {
+			tree.reset(tree_nodes);
+		}
+	}
+	// turns pondering on or off, see ponder(). It needs the mcts tree
+	// whatever the search is
+	void set_ponder(bool on) {
+		pondering = on;
+		if(pondering) {
+			tree.reset(tree_nodes);
+		}
+	}
+	// turns the amaf statistics of the flat and halving searches on or
+	// off, k is the rave parameter, see value()
+	void set_amaf(bool on, double k) {
+		amaf = on;
+		rave = k > 0? k: 1;
+	}
+	// sets the memory of the transposition table in megabytes, 0 = off
+	void set_tt(size_t megabytes) {
+		tt.resize(megabytes);
+	}
+	// turns the filling in of dead and captured tiles before every search
+	// on or off, see fill_in()
+	void set_prune(bool on) {
+		prune = on;
+	}
+	// solves positions with at most cells empty tiles exactly, searching
+	// at most nodes positions per move, see solver.h. 0 cells = never
+	void set_solver(size_t cells, size_t nodes) {
+		solve_cells = cells;
+		if(solve_cells) {
+			solver.reset(16, nodes); // 512 kB of solved positions
+		}
+	}
+	// number of tiles fill_in() took from the candidates of the last move
+	size_t get_pruned() const {
+		return pruned;
+	}
+	// maps the opening book in path, false if it is not a book for this
+	// board side
+	bool set_book(const char *path) {
+		return book.open(path, side);
+	}
+	// key of the current position in an opening book, see book.h
+	uint64_t position_key(bool &turned) const {
+		return book_key(hash, rhash, turned);
+	}
+	// plays tile t for the player to move and passes the move on, as in a
+	// game: lets a caller such as bookgen.cpp set up a position. Returns
+	// the error of try_move()
+	int play_move(size_t t) {
+		if(int e = try_move(t / side, t % side)) {
+			return e;
+		}
+		check_game_over();
+		whites_move = whites_move? false: true;
+		return 0;
+	}
+	char get_winner() const {
+		return winner;
+	}
+	// switches to time control, see timecontrol.h: ms per move and/or ms
+	// for the whole game, 0 for none
+	void set_clock(double move_ms, double game_ms) {
+		clock.set_move_time(move_ms);
+		clock.set_game_time(game_ms);
+	}
+	// sets the playouts per candidate of a move, autoplay() does it too
+	void set_iterations(size_t n) {
+		nshuffles = n;
+	}
+	// sets the number of threads used by the search, 0 means one thread
+	// per hardware core. Every worker gets its own random engine seeded
+	// from the main one, so that their streams are independent
+	void set_threads(size_t n) {
+		if(!n) {
+			n = thread::hardware_concurrency();
+			n = n? n: 1;
+		}
+		pool.reset(); // stop the old threads before touching workers
+		workers.resize(n);
+		for(auto &w : workers) {
+			w.rng.seed((*randengine)());
+			w.amaf_wins.assign(size, 0);
+			w.amaf_visits.assign(size, 0);
+		}
+		pool.reset(new WorkerPool(n));
+	}
+	// seeds the main random engine, and the workers' engines from it, in
+	// place of the clock, so that a game can be played again. With more
+	// than one thread the results still depend on the scheduling
+	void set_seed(unsigned seed) {
+		randengine->seed(seed);
+		for(auto &w : workers) {
+			w.rng.seed((*randengine)());
+		}
 	}
 	// returns side of the board or 0 if the board is not initialized
 	unsigned char get_side() {
@@ -122,8 +580,8 @@ public:
 		if(!init_success) {
 			return;
 		}
-		for(auto cur : stone) {
-			cout << cur << ' ';
+		for(auto it = stone.begin(); it != stone.begin() + size; ++it) {
+			cout << *it << ' ';
 		}
 		cout << endl;
 	}
@@ -146,9 +604,9 @@ public:
 			for(int j = 0; j < side; j++) {
 				// << tile [i * side + j];
 				// i is row, j is col
-				if(blackrow[i] & uint32_t(1) << j) {
+				if(blackrow[i] & Row(1) << j) {
 					cout << 'X';
-				} else if(whitecol[j] & uint32_t(1) << i) {
+				} else if(whitecol[j] & Row(1) << i) {
 					cout << 'O';
 				} else {
 					cout << '.';
@@ -170,8 +628,8 @@ public:
 		cout << endl;
 	}
 	// checks a vector for connectedness whether it's black or white stones
-	bool is_connected(vector<uint32_t> &row) {
-		uint32_t a, b, c, s; // temporary variables
+	bool is_connected(const Lines &row) {
+		Row a, b, c, s; // temporary variables
 		a = row[0];
 		// iterate row by row
 		for(auto r = row.begin() + 1; r != row.end(); ++r) {
@@ -220,136 +678,772 @@ public:
 		return true;
 	}
 	// checks if game is over and sets winner to X=black or O=white
+	// links is updated with every stone, so this takes O(1). Unlike
+	// is_connected, which only follows stones from one row to the next and
+	// misses a path that turns back towards the first row, it finds every
+	// connection
 	void check_game_over() {
-		if(is_connected(blackrow)) { // check black side
-			winner = 'X';
-		} else if(is_connected(whitecol)) { // check white side
-			winner = 'O';
-		}
+		winner = links.winner();
 	}
-	// checks if white would win in current stones configuration
-	bool is_white_winning() {
-		vector<uint32_t> wcol(whitecol); // local array of white columns
+	// checks if white would win when the stones [first, last) of the stone
+	// array are added to the white stones on the board. wcol is scratch
+	// space provided by the caller so that no playout allocates
+	bool is_white_winning(typename Stones::iterator first,
+			typename Stones::iterator last, Lines &wcol) {
+		wcol = whitecol; // local array of white columns
 		// fill out the wcol vector with stones that are off the board
-		for(auto it = cur0; it != middle; ++it) {
-			wcol[(*it) % side] |=
-				uint32_t(1) << ((*it) / side);
+		for(auto it = first; it != last; ++it) {
+			wcol[(*it) % side] |= Row(1) << ((*it) / side);
 		}
 		return is_connected(wcol); // check if connection exists
 	}
+	// first step of random_fill: adds every tile of w.empty to w.wcol with
+	// probability 1/2 and returns how many were added. Rows of up to 32
+	// tiles take the bits of two columns from every random number
+	size_t random_half(Worker &w, true_type) {
+		size_t count = 0;
+		for(int c = 0; c < side; c += 2) {
+			uint64_t r = w.rng();
+			uint32_t bits = uint32_t(r) & w.empty[c];
+			w.wcol[c] |= bits;
+			count += __builtin_popcount(bits);
+			if(c + 1 < side) {
+				bits = uint32_t(r >> 32) & w.empty[c + 1];
+				w.wcol[c + 1] |= bits;
+				count += __builtin_popcount(bits);
+			}
+		}
+		return count;
+	}
+	size_t random_half(Worker &w, false_type) {
+		size_t count = 0;
+		for(int c = 0; c < side; ++c) {
+			Row bits;
+			random_row(w.rng, bits);
+			bits &= w.empty[c];
+			w.wcol[c] |= bits;
+			count += count_bits(bits);
+		}
+		return count;
+	}
+	// random fill for one playout: adds k of the empty tiles in w.empty to
+	// w.wcol, so that every k-subset of them is equally likely. Each empty
+	// tile is first taken with probability 1/2 by masking random bits with
+	// the empty tiles of two columns at a time, then random tiles are
+	// dropped or added until exactly k are taken. Since no step favours any
+	// tile over another, the result is uniform, just like taking the first
+	// k stones after a shuffle, but with no shuffle and no per-stone loop.
+	// Only tiles in w.empty are ever set, so wcol can hold the white stones
+	// that are already on the board
+	void random_fill(Worker &w, size_t k) {
+		size_t count = random_half(w, Narrow());
+		// fix the count, on average this takes about sqrt(n) tries
+		while(count != k) {
+			// pick a random empty tile (multiply-shift, no division)
+			size_t t = empties[((w.rng() >> 32) * empties.size()) >>
+				32];
+			Row bit = Row(1) << (t / side);
+			Row &col = w.wcol[t % side];
+			if(!(w.empty[t % side] & bit)) {
+				continue; // this is the candidate move itself
+			}
+			if(count > k && (col & bit)) {
+				col ^= bit;
+				--count;
+			} else if(count < k && !(col & bit)) {
+				col |= bit;
+				++count;
+			}
+		}
+	}
+	// all moves as first: credits one playout to every tile that was empty
+	// at the root and ended up in the color of the player to move, the
+	// candidate included. wcol points to the white columns of the fill,
+	// stride apart, and won tells if the player to move won it
+	void credit_amaf(Worker &w, const Row *wcol, size_t stride,
+			bool won) {
+		for(int c = 0; c < side; ++c) {
+			Row ours = (whites_move? wcol[c * stride]:
+				~wcol[c * stride]) & emptycol[c];
+			for(; ours; ours = drop_lowest(ours)) {
+				size_t t = lowest_bit(ours) * side + c;
+				++w.amaf_visits[t];
+				w.amaf_wins[t] += won;
+			}
+		}
+	}
+	// checks the PLAYOUT_LANES fills of w.batch, connected[i] is non-zero
+	// if the i-th fill is connected. Rows wider than 32 tiles do not fit
+	// the lanes of connected_lanes and are checked one by one
+	void check_lanes(Worker &w, uint32_t *connected, true_type) {
+		connected_lanes<Side>(w.batch.data(), connected);
+	}
+	void check_lanes(Worker &w, uint32_t *connected, false_type) {
+		for(int l = 0; l < PLAYOUT_LANES; ++l) {
+			for(int c = 0; c < side; ++c) {
+				w.wcol[c] = w.batch[c * PLAYOUT_LANES + l];
+			}
+			connected[l] = is_connected(w.wcol);
+		}
+	}
+	// the flood fill of floodfill.h, false on boards above 11x11
+	bool flood(const Lines &l, true_type) {
+		return flood_connected(l.data(), side);
+	}
+	bool flood(const Lines &l, false_type) {
+		return false;
+	}
+	// does n playouts, each adding k random tiles of w.empty to the white
+	// stones in w.base, and returns the number of white wins, crediting
+	// every playout to credit_amaf if amaf is set. The fills are checked
+	// PLAYOUT_LANES at a time by connected_lanes, or one by one by the
+	// flood fill if built with -DFLOOD_PLAYOUTS and side is up to 11:
+	// slower, but exact where the row scan misses winding paths
+	size_t fill_playouts(Worker &w, size_t k, size_t n, bool amaf = false) {
+		size_t white_wins = 0;
+#ifdef FLOOD_PLAYOUTS
+		if(side <= 11) {
+			for(size_t j = 0; j < n; ++j) {
+				w.wcol = w.base;
+				random_fill(w, k);
+				bool white = flood(w.wcol, Narrow());
+				white_wins += white;
+				if(amaf) {
+					credit_amaf(w, w.wcol.data(), 1,
+						white == whites_move);
+				}
+			}
+			return white_wins;
+		}
+#endif
+		// one batch of PLAYOUT_LANES fills at a time
+		for(size_t j = 0; j < n; j += PLAYOUT_LANES) {
+			int m = n - j < PLAYOUT_LANES? n - j: PLAYOUT_LANES;
+			for(int l = 0; l < m; ++l) {
+				w.wcol = w.base;
+				random_fill(w, k);
+				for(int c = 0; c < side; ++c) {
+					w.batch[c * PLAYOUT_LANES + l] = w.wcol[c];
+				}
+			}
+			uint32_t a[PLAYOUT_LANES];
+			check_lanes(w, a, Narrow());
+			for(int l = 0; l < m; ++l) {
+				white_wins += a[l] != 0;
+				if(amaf) {
+					credit_amaf(w, &w.batch[l], PLAYOUT_LANES,
+						(a[l] != 0) == whites_move);
+				}
+			}
+		}
+		return white_wins;
+	}
+	// does n playouts for candidate move mv with k random white stones
+	// and returns the number of wins for the player to move
+	size_t run_playouts(Worker &w, size_t mv, size_t k, size_t n) {
+		Row bit = Row(1) << (mv / side);
+		w.base = basecol;
+		if(whites_move) {
+			w.base[mv % side] |= bit;
+		}
+		// the candidate is not part of the random fill
+		w.empty[mv % side] ^= bit;
+		size_t white_wins = fill_playouts(w, k, n, amaf);
+		w.empty[mv % side] |= bit;
+		return whites_move? white_wins: n - white_wins;
+	}
+	// body of a search thread: takes candidates from the first round_moves
+	// of the shared moves list one at a time until none are left, does
+	// round_playouts for each of them and adds the wins to tile. Works on
+	// private bitmaps so that all workers can run playouts at the same time
+	void search_worker(size_t id) {
+#ifdef COUNT_ALLOCS
+		size_t allocs = alloc_count;
+#endif
+		Worker &w = workers[id];
+		w.empty = emptycol;
+		// white stones that are off the board, one of them is the
+		// candidate itself if white is to move
+		size_t k = white_left - (whites_move? 1: 0);
+		for(size_t i = next_move++; i < round_moves; i = next_move++) {
+			if(clock.enabled() && clock.expired()) {
+				break; // out of time, leave the rest
+			}
+			// do the Monte-Carlo based on this move
+			tile[moves[i]] += run_playouts(w, moves[i], k,
+				round_playouts);
+			visits[moves[i]] += round_playouts;
+		}
+#ifdef COUNT_ALLOCS
+		if(id) { // worker 0 is counted by make_move
+			search_allocs += alloc_count - allocs;
+		}
+#endif
+	}
+	// gives n more playouts to each of the first alive candidates in moves,
+	// spread over the worker threads
+	void search_round(size_t alive, size_t n) {
+		round_moves = alive;
+		round_playouts = n;
+		next_move = 0;
+		pool->run([this](size_t id) { search_worker(id); });
+		if(amaf) {
+			// on a symmetric board a tile and its mirror image are
+			// worth the same, their candidate gets both counts
+			for(auto &w : workers) {
+				for(auto mv : empties) {
+					size_t to = symmetric? min(mv, mirror(mv)): mv;
+					amaf_wins[to] += w.amaf_wins[mv];
+					amaf_visits[to] += w.amaf_visits[mv];
+					w.amaf_wins[mv] = 0;
+					w.amaf_visits[mv] = 0;
+				}
+			}
+		}
+	}
+	// share of wins of candidate mv. With amaf it is blended with the amaf
+	// share as in RAVE: the amaf weight beta = sqrt(rave / (3 n + rave))
+	// starts at 1 and fades as the n direct playouts of mv add up, since
+	// amaf values are available much earlier but are biased
+	double value(size_t mv) {
+		double n = visits[mv];
+		double direct = n? tile[mv] / n: 0;
+		if(!amaf || !amaf_visits[mv]) {
+			return direct;
+		}
+		double beta = sqrt(rave / (3 * n + rave));
+		return (1 - beta) * direct +
+			beta * amaf_wins[mv] / amaf_visits[mv];
+	}
+	// true if candidate a has a better share of wins than b, candidates
+	// that have not been tried yet come last
+	bool better(size_t a, size_t b) {
+		if(amaf) {
+			return value(a) > value(b);
+		}
+		return size_t(tile[a]) * visits[b] > size_t(tile[b]) * visits[a] ||
+			(visits[a] && !visits[b]);
+	}
+	// plain flat Monte-Carlo: nshuffles playouts for every candidate, or
+	// timed_playouts at a time until the clock runs out. Returns the first
+	// move with the best share of wins
+	size_t search_flat() {
+		if(clock.enabled()) {
+			do {
+				search_round(moves.size(), timed_playouts);
+			} while(!clock.expired());
+		} else {
+			search_round(moves.size(), nshuffles);
+		}
+		size_t max = moves[0]; // move with maximum value
+		for(auto mv : moves) {
+			if(better(mv, max)) {
+				max = mv;
+			}
+		}
+		return max;
+	}
+	// successive halving: the budget of the flat search, nshuffles per
+	// candidate, is spent in rounds. Each round gives every remaining
+	// candidate an equal share of budget / rounds and then drops the worse
+	// half, so hopeless moves get few playouts and the last contenders get
+	// many. With time control every round gets an equal share of the
+	// time instead
+	size_t search_halving() {
+		size_t alive = moves.size();
+		size_t budget = alive * nshuffles;
+		size_t rounds = 0;
+		for(size_t n = alive; n > 1; n = (n + 1) / 2) {
+			++rounds;
+		}
+		for(size_t r = 0; r < rounds; ++r) {
+			if(clock.enabled()) {
+				auto until = clock.split(double(r + 1) / rounds);
+				do {
+					search_round(alive, timed_playouts);
+				} while(chrono::steady_clock::now() < until);
+			} else {
+				size_t n = budget / (alive * rounds);
+				search_round(alive, n? n: 1);
+			}
+			sort(moves.begin(), moves.begin() + alive,
+				[this](size_t a, size_t b) {
+					return better(a, b);
+				});
+			alive = (alive + 1) / 2;
+		}
+		return moves[0];
+	}
+	// UCT tree search, see mcts.h: every iteration walks down the tree by
+	// UCB1, expands the leaf it reaches if it has been visited before and
+	// does one batch of PLAYOUT_LANES playouts from there, which is why the
+	// same number of playouts as the flat search gives about 1 /
+	// PLAYOUT_LANES as many iterations. The tree left by the last search
+	// is kept if it contains the last two moves, so its playouts count
+	// again. Runs on worker 0 only. Returns the most visited move
+	size_t search_mcts() {
+		Worker &w = workers[0];
+		size_t root = tree.compact();
+#ifdef SEARCH_STATS
+		auto start = chrono::steady_clock::now();
+		size_t reused = tree.node(root).visits; // playouts kept
+		size_t kept = tree.size(); // nodes kept
+#endif
+		size_t budget = moves.size() * nshuffles;
+		size_t iterations = 0;
+		for(size_t done = 0; clock.enabled()? !clock.expired():
+			done < budget; done += PLAYOUT_LANES) {
+			mcts_iteration(w, root);
+			++iterations;
+		}
+#ifdef SEARCH_STATS
+		auto end = chrono::steady_clock::now();
+		double t = chrono::duration<double>(end - start).count();
+		TreeNode &r = tree.node(root);
+		cerr << "mcts: " << iterations << " iterations, " <<
+			size_t(iterations / t) << " nodes/s, tree " <<
+			tree.size() << " nodes (" << kept << " kept), " <<
+			tree.size() * sizeof(TreeNode) / 1024 << " of " <<
+			tree.memory() / 1024 << " KB, " << 100.0 * reused /
+			r.visits << "% of playouts reused\n";
+#endif
+		return tree.node(tree.best()).move;
+	}
+	// one iteration of the mcts search from the root: walks down to a
+	// leaf, expands it if it has been visited before, does PLAYOUT_LANES
+	// playouts and adds their results to every node on the way, and to
+	// the transposition table if there is one
+	void mcts_iteration(Worker &w, size_t root) {
+		w.base = basecol;
+		w.empty = emptycol;
+		bool white = whites_move; // to move at the current node
+		size_t k = white_left; // white stones yet to be played
+		size_t i = root;
+		uint64_t h = hash; // hash of the position of node i
+		uint64_t rh = rhash; // and of its 180 degree turn
+		path.clear();
+		path.push_back(i);
+		path_hash.clear();
+		path_hash.push_back(canonical_key(h, rh));
+		while(true) {
+			if(!tree.node(i).count) {
+				// expand a visited leaf with all its moves
+				if(!tree.node(i).visits ||
+					!expand(i, w, h, rh, white)) {
+					break;
+				}
+			}
+			i = tree.select(i);
+			size_t mv = tree.node(i).move;
+			Row bit = Row(1) << (mv / side);
+			w.empty[mv % side] ^= bit;
+			if(white) {
+				w.base[mv % side] |= bit;
+				--k;
+			}
+			h ^= zobrist_key(mv, white);
+			rh ^= zobrist_key(size - 1 - mv, white);
+			white = !white;
+			path.push_back(i);
+			path_hash.push_back(canonical_key(h, rh));
+		}
+		size_t white_wins = fill_playouts(w, k, PLAYOUT_LANES);
+		// the root is the opponent's move, then moves alternate
+		for(size_t d = 0; d < path.size(); ++d) {
+			TreeNode &x = tree.node(path[d]);
+			uint32_t wins = whites_move != (d % 2 == 0)? white_wins:
+				PLAYOUT_LANES - white_wins;
+			x.visits += PLAYOUT_LANES;
+			x.wins += wins;
+			if(tt.enabled()) {
+				tt.add(path_hash[d], wins, PLAYOUT_LANES);
+			}
+		}
+	}
+	// thinks on the opponent's time: grows the mcts tree of the current
+	// position, with the opponent to move, until stop is set, see
+	// play_protocol(). try_move then keeps the subtree of the opponent's
+	// move: search=mcts goes on from it and the other searches start from
+	// the statistics of its children
+	void ponder(const atomic<bool> &stop) {
+		if(!pondering || winner != ' ' || cur0 == cur1) {
+			return;
+		}
+		empties.assign(cur0, cur1);
+		fill(emptycol.begin(), emptycol.end(), 0);
+		for(auto mv : empties) {
+			emptycol[mv % side] |= Row(1) << (mv / side);
+		}
+		basecol = whitecol;
+		white_left = middle - cur0;
+		size_t root = tree.compact();
+		size_t iterations = 0;
+		// stop well before the 32 bit counters of the tree overflow
+		while(!stop && tree.node(root).visits < (uint32_t(1) << 30)) {
+			mcts_iteration(workers[0], root);
+			++iterations;
+		}
+#ifdef SEARCH_STATS
+		cerr << "ponder: " << iterations << " iterations, tree " <<
+			tree.size() << " nodes\n";
+#endif
+	}
+	// adds the empty tiles of w.empty as children of leaf i, whose
+	// position has hash h, rotated hash rh and white to move if white is
+	// set. A symmetric position only gets one child per mirrored pair.
+	// Children that the transposition table knows start from its
+	// statistics
+	bool expand(size_t i, Worker &w, uint64_t h, uint64_t rh, bool white) {
+		children.clear();
+		for(int c = 0; c < side; ++c) {
+			for(Row e = w.empty[c]; e; e = drop_lowest(e)) {
+				size_t t = lowest_bit(e) * side + c;
+				if(h != rh || t <= mirror(t)) {
+					children.push_back(t);
+				}
+			}
+		}
+		if(children.empty() ||
+			!tree.expand(i, children.begin(), children.end())) {
+			return false;
+		}
+		if(tt.enabled()) {
+			TreeNode &x = tree.node(i);
+			for(size_t c = x.first; c < x.first + x.count; ++c) {
+				TreeNode &y = tree.node(c);
+				tt.probe(key_after(h, rh, y.move, white), y.wins,
+					y.visits);
+			}
+		}
+		return true;
+	}
+	// gives the dead and captured tiles among empties to the color that
+	// can have them (see inferior.h): they leave empties and emptycol and
+	// white's go to basecol. The players then take turns on the tiles
+	// that are left, which sets white_left. Leaves everything as it is if
+	// no empty tile would be left. Returns the number of tiles filled
+	size_t fill_in() {
+		fill(cells.begin(), cells.end(), ' ');
+		for(int r = 0; r < side; ++r) {
+			for(int c = 0; c < side; ++c) {
+				if(blackrow[r] & Row(1) << c) {
+					cells[r * side + c] = 'X';
+				} else if(whitecol[c] & Row(1) << r) {
+					cells[r * side + c] = 'O';
+				}
+			}
+		}
+		size_t filled = fill_inferior(cells.data(), side);
+		if(!filled || filled == empties.size()) {
+			return 0;
+		}
+		size_t kept = 0;
+		for(auto mv : empties) {
+			Row bit = Row(1) << (mv / side);
+			if(cells[mv] == ' ') {
+				empties[kept++] = mv;
+				continue;
+			}
+			emptycol[mv % side] ^= bit;
+			if(cells[mv] == 'O') {
+				basecol[mv % side] |= bit;
+			}
+		}
+		empties.resize(kept);
+		white_left = whites_move? (kept + 1) / 2: kept / 2;
+		return filled;
+	}
+	// runs the exact solver on the current position, see solver.h. It only
+	// knows rows of up to 32 tiles, larger boards are never solved
+	EndgameSolver::Result solve_endgame(int &mv, true_type) {
+		return solver.solve(side, blackrow.data(), whitecol.data(),
+			whites_move, hash, rhash, mv, clock.enabled(),
+			clock.split(0.5));
+	}
+	EndgameSolver::Result solve_endgame(int &mv, false_type) {
+		return EndgameSolver::unknown;
+	}
+	// the tile a 180 degree turn of the board takes t to
+	size_t mirror(size_t t) const {
+		return size - 1 - t;
+	}
+	// transposition table key of the position after white (if set) or
+	// black plays mv in the position with hash h and rotated hash rh
+	uint64_t key_after(uint64_t h, uint64_t rh, size_t mv, bool white)
+			const {
+		return canonical_key(h ^ zobrist_key(mv, white),
+			rh ^ zobrist_key(mirror(mv), white));
+	}
+	// true if tile t has no stone
+	bool is_empty(size_t t) const {
+		return !(blackrow[t / side] & Row(1) << (t % side)) &&
+			!(whitecol[t % side] & Row(1) << (t / side));
+	}
 	// ai move, tricky part here is that since the whites are on top of
 	// our stone array and blacks are on bottom, playing for one color is
-	// slightly different than the other. Returns the move made
-	size_t make_move() {
+	// slightly different than the other. Leaves the move in best, size
+	// if there is none
+	void think() {
+		best = size;
 		if(!init_success) {
-			return size; // return an invalid move to indicate error
+			return;
+		}
+		pruned = 0;
+		size_t mv; // the book move, if the book knows this position
+		if(book.is_open() && book.find(hash, rhash, mv) && mv < size &&
+			is_empty(mv)) {
+			best = mv;
+			return;
+		}
+#ifdef COUNT_ALLOCS
+		search_allocs = 0;
+		size_t allocs = alloc_count;
+#endif
+		if(clock.enabled()) {
+			clock.start(cur1 - cur0, size);
+		}
+		if(solve_cells && size_t(cur1 - cur0) <= solve_cells) {
+			// a proven win is played at once. A loss or a solve that
+			// ran out of nodes or of half the time of the move leaves
+			// the move to the search below
+			int win_mv;
+			auto result = solve_endgame(win_mv, Narrow());
+#ifdef SEARCH_STATS
+			cerr << "solver: " << solver.searched() << " nodes, " <<
+				(result == EndgameSolver::win? "win":
+				result == EndgameSolver::loss? "loss": "unknown") <<
+				'\n';
+#endif
+			if(result == EndgameSolver::win) {
+				if(clock.enabled()) {
+					clock.stop();
+				}
+				best = win_mv;
+				return;
+			}
 		}
 		// if the number of tiles on board is side-1 and more, before
 		// doing 1000 Monte-Carlo runs it makes sense to check if adding
 		// a single tile can win the game by trying each possible move
 		// once and checking if resulting position will be a win.
 		// For simplicity we'll just do this check at every move
-		shuffle(cur0, cur1, *randengine);
-		uint32_t a;
-		int i;
-		size_t max; // move with maximum value
-		if(whites_move) {
-			// do a monte-carlo simulation
-			vector<size_t> moves(cur0, cur1); // we must copy
-				// avaliable moves or after shuffling
-				// we'll lose track of which one have been
-				// checked
-			vector<int> tile(size); // display values for debugging
-			size_t win_count; // count number of wins for white
-			size_t max_count = 0; // wins on the best move
-			for(auto it = moves.begin(); it != moves.end(); ++it) {
-				win_count = 0;
-				// do the swap so this move is reflected in
-				// the stone vector
-				auto pickmove = find(cur0, cur1, *it);
-				*pickmove = *cur0;
-				*cur0 = *it;
-				// do the Monte-Carlo based on this move
-				for(int j = 0; j < nshuffles; ++j) {
-					shuffle(cur0 + 1, cur1, *randengine);
-					if(is_white_winning()) {
-						++win_count;
-					}
-				}
-				if(win_count > max_count) {
-					max = *it;
-					max_count = win_count;
-				}
-				tile[*it] = win_count;
+		stone.shuffle(cur0, cur1, *randengine);
+		stone.reindex(cur0, cur1);
+		if(!whites_move) {
+			--cur1; // black's move will go to this slot
+		}
+		// we must copy avaliable moves or after shuffling we'll lose
+		// track of which one have been checked
+		empties.assign(cur0, whites_move? cur1: cur1 + 1);
+		fill(emptycol.begin(), emptycol.end(), 0);
+		for(auto mv : empties) {
+			emptycol[mv % side] |= Row(1) << (mv / side);
+			tile[mv] = 0;
+			visits[mv] = 0;
+			amaf_wins[mv] = 0;
+			amaf_visits[mv] = 0;
+		}
+		// a position that is its own 180 degree turn, such as the empty
+		// board, has the same value after a move as after its mirror
+		// image, so only the first of the two is searched. The hashes
+		// of a position and its turn only match if the stones do
+		symmetric = hash == rhash;
+		basecol = whitecol;
+		white_left = middle - cur0;
+		pruned = prune? fill_in(): 0;
+		if(pruned && search == mcts) {
+			tree.reset(tree.capacity()); // it has the filled tiles
+		}
+		moves.clear();
+		for(auto mv : empties) {
+			if(!symmetric || mv <= mirror(mv)) {
+				moves.push_back(mv);
+			}
+		}
+		if(tt.enabled() && search != mcts) {
+			// start from what is known about the positions after each
+			// candidate, this includes the playouts of ponder()
+			for(auto mv : moves) {
+				uint32_t wins = 0, n = 0;
+				tt.probe(key_after(hash, rhash, mv, whites_move),
+					wins, n);
+				tile[mv] = wins;
+				visits[mv] = n;
 			}
-			// draw the table - for debugging
+		} else if(pondering && search != mcts) {
+			// start from what ponder() found for this position
+			TreeNode &r = tree.node(tree.compact());
+			for(size_t c = r.first; c < r.first + r.count; ++c) {
+				tile[tree.node(c).move] = tree.node(c).wins;
+				visits[tree.node(c).move] = tree.node(c).visits;
+			}
+		}
+		// do a monte-carlo simulation, candidates are spread over the
+		// worker threads
+		size_t max = search == halving? search_halving():
+			search == mcts? search_mcts(): search_flat();
+		if(tt.enabled() && search != mcts) {
+			for(auto mv : moves) {
+				tt.store(key_after(hash, rhash, mv, whites_move),
+					tile[mv], visits[mv]);
+			}
+		}
+		// draw the table - for debugging
 /*
-			cout << "White move values:\n";
-			for(int j = 0; j < size; j++) {
-				if(!(j % side)) {
-					cout << '\n';
-				}
-				cout << '\t' << tile[j];
+		cout << (whites_move? "White": "Black") << " move values:\n";
+		for(int j = 0; j < size; j++) {
+			if(!(j % side)) {
+				cout << '\n';
 			}
-			cout << '\n';
+			cout << '\t' << tile[j];
+		}
+		cout << '\n';
 */
-			// make the best move
-			auto it = find(cur0, cur1, max);
-			*it = *cur0;
-			*cur0 = max;
-			// update whitecol
-			whitecol[(*cur0) % side] |=
-				uint32_t(1) << ((*cur0) / side);
-			cur0++;
-		} else {
-			--cur1;
-			// do a monte-carlo simulation
-			vector<size_t> moves(cur0, cur1 + 1); // we must copy
-				// avaliable moves or after shuffling
-				// we'll lose track of which one have been
-				// checked
-			vector<int> tile(size); // display values for debugging
-			size_t win_count; // count number of wins for black
-			size_t max_count = 0; // wins on the best move
-			for(auto it = moves.begin(); it != moves.end(); ++it) {
-				win_count = 0;
-				// do the swap so this move is reflected in
-				// the stone vector
-				auto pickmove = find(cur0, cur1, *it);
-				*pickmove = *cur1;
-				*cur1 = *it;
-				// do the Monte-Carlo based on this move
-				for(int j = 0; j < nshuffles; ++j) {
-					shuffle(cur0, cur1, *randengine);
-					if(!is_white_winning()) {
-						++win_count;
+		if(!whites_move) {
+			++cur1; // the slot of black's move is free again
+		}
+		best = max;
+		if(clock.enabled()) {
+			clock.stop();
+		}
+#ifdef COUNT_ALLOCS
+		search_allocs += alloc_count - allocs;
+		if(search_allocs) {
+			cerr << "E: " << search_allocs <<
+				" heap allocations during search\n";
+			abort();
+		}
+#endif
+	}
+	size_t best_move() const {
+		return best;
+	}
+	// searches and plays the best move for the player to move, without
+	// passing the move on. Returns the move made
+	size_t make_move() {
+		think();
+		if(best < size) {
+			try_move(best / side, best % side);
+		}
+		return best;
+	}
+	// playout benchmark: prints playouts per second of the original random
+	// fill (default_random_engine + shuffle of the stone array), of
+	// random_fill() and of random_fill() with batched connectivity checks,
+	// on positions with 0, 1/3 and 2/3 of the tiles filled at random. The
+	// share of white wins should be the same for all of them, and every
+	// lane of connected_lanes() must agree with is_connected()
+	void bench_playouts(size_t n) {
+		for(int part = 0; part < 3; ++part) {
+			reset(false, false);
+			while((size - (cur1 - cur0)) < size * part / 3) {
+				stone.shuffle(cur0, cur1, *randengine);
+				stone.reindex(cur0, cur1);
+				try_move(*cur0 / side, *cur0 % side);
+				whites_move = whites_move? false: true;
+			}
+			Worker &w = workers[0];
+			size_t wins = 0; // white wins
+			auto start = chrono::steady_clock::now();
+			for(size_t j = 0; j < n; ++j) {
+				stone.shuffle(cur0, cur1, *randengine);
+				wins += is_white_winning(cur0, middle, w.wcol);
+			}
+			auto end = chrono::steady_clock::now();
+			double t0 = chrono::duration<double>(end - start).count();
+			stone.reindex(cur0, cur1);
+			empties.assign(cur0, cur1);
+			fill(emptycol.begin(), emptycol.end(), 0);
+			for(auto mv : empties) {
+				emptycol[mv % side] |= Row(1) << (mv / side);
+			}
+			w.empty = emptycol;
+			size_t wins1 = 0;
+			start = chrono::steady_clock::now();
+			for(size_t j = 0; j < n; ++j) {
+				w.wcol = whitecol;
+				random_fill(w, middle - cur0);
+				wins1 += is_connected(w.wcol);
+			}
+			end = chrono::steady_clock::now();
+			double t1 = chrono::duration<double>(end - start).count();
+			size_t wins2 = 0;
+			start = chrono::steady_clock::now();
+			for(size_t j = 0; j < n; j += PLAYOUT_LANES) {
+				for(int l = 0; l < PLAYOUT_LANES; ++l) {
+					w.wcol = whitecol;
+					random_fill(w, middle - cur0);
+					for(int c = 0; c < side; ++c) {
+						w.batch[c * PLAYOUT_LANES + l] =
+							w.wcol[c];
 					}
 				}
-				if(win_count > max_count) {
-					max = *it;
-					max_count = win_count;
+				uint32_t a[PLAYOUT_LANES];
+				check_lanes(w, a, Narrow());
+				for(int l = 0; l < PLAYOUT_LANES; ++l) {
+					wins2 += a[l] != 0;
 				}
-				tile[*it] = win_count;
 			}
-			// draw the table - for debugging
-/*			cout << "Black move values:\n";
-			for(int j = 0; j < size; j++) {
-				if(!(j % side)) {
-					cout << '\n';
+			end = chrono::steady_clock::now();
+			double t2 = chrono::duration<double>(end - start).count();
+			size_t n2 = (n + PLAYOUT_LANES - 1) / PLAYOUT_LANES *
+				PLAYOUT_LANES; // playouts done in whole batches
+			// cross-check every lane against is_connected
+			size_t mismatches = 0;
+			bool expect[PLAYOUT_LANES];
+			for(size_t j = 0; j < n; j += PLAYOUT_LANES) {
+				for(int l = 0; l < PLAYOUT_LANES; ++l) {
+					w.wcol = whitecol;
+					random_fill(w, middle - cur0);
+					for(int c = 0; c < side; ++c) {
+						w.batch[c * PLAYOUT_LANES + l] =
+							w.wcol[c];
+					}
+					expect[l] = is_connected(w.wcol);
+				}
+				uint32_t a[PLAYOUT_LANES];
+				check_lanes(w, a, Narrow());
+				for(int l = 0; l < PLAYOUT_LANES; ++l) {
+					mismatches += (a[l] != 0) != expect[l];
 				}
-				cout << '\t' << tile[j];
 			}
-			cout << '\n';
-*/
-			// make the best move
-			auto it = find(cur0, cur1 + 1, max);
-			*it = *cur1;
-			*cur1 = max;
-			// update blackrow
-			blackrow[(*cur1) / side] |=
-				uint32_t(1) << ((*cur1) % side);
+			cout << (int)side << 'x' << (int)side << ", " <<
+				(size - empties.size()) << " stones on board:\n"
+				"  shuffle:     " << setw(10) << size_t(n / t0) <<
+				" playouts/s, white wins " << 100.0 * wins / n <<
+				"%\n  random_fill: " << setw(10) <<
+				size_t(n / t1) << " playouts/s, white wins " <<
+				100.0 * wins1 / n << "%\n  batched x" <<
+				setw(2) << PLAYOUT_LANES << ":  " << setw(10) <<
+				size_t(n2 / t2) << " playouts/s, white wins " <<
+				100.0 * wins2 / n2 << "%, " << mismatches <<
+				" lanes differ from is_connected\n";
+			if(side > 11) {
+				continue;
+			}
+			// the flood fill of floodfill.h, which also finds the
+			// winding paths the row scan misses
+			size_t wins3 = 0;
+			start = chrono::steady_clock::now();
+			for(size_t j = 0; j < n; ++j) {
+				w.wcol = whitecol;
+				random_fill(w, middle - cur0);
+				wins3 += flood(w.wcol, Narrow());
+			}
+			end = chrono::steady_clock::now();
+			double t3 = chrono::duration<double>(end - start).count();
+			size_t missed = 0; // connections the row scan misses
+			for(size_t j = 0; j < n; ++j) {
+				w.wcol = whitecol;
+				random_fill(w, middle - cur0);
+				missed += flood(w.wcol, Narrow()) &&
+					!is_connected(w.wcol);
+			}
+			cout << "  flood fill:  " << setw(10) << size_t(n / t3) <<
+				" playouts/s, white wins " << 100.0 * wins3 / n <<
+				"%, " << missed << " connections missed by "
+				"is_connected\n";
 		}
-		return max;
 	}
 	// human move
 	int try_move(unsigned char row, unsigned char col) {
@@ -357,41 +1451,40 @@ public:
 			return -100;
 		}
 		// check bounds
-		if(row > side || col > side) {
+		if(row >= side || col >= side) {
 			cout << (int)col << " error " << (int)row << endl;
 			return -1; // error: one of the values is out of bounds
 		}
 		// check if this tile is empty
 		size_t ind = row * side + col;
-		if((blackrow[row] & (uint32_t(1) << col)) ||
-			(whitecol[col] & (uint32_t(1) << row))) {
+		if((blackrow[row] & (Row(1) << col)) ||
+			(whitecol[col] & (Row(1) << row))) {
 			return -2; // error: this tile is not empty
 		}
 		switch(whites_move) {
 		case false:
 		{
 			// update blackrow:
-			blackrow[row] |= uint32_t(1) << col;
-			// we must also update stone vector
-			auto it = find(cur0, cur1, ind);
-			// we must swap two stones
+			blackrow[row] |= Row(1) << col;
+			links.place(row, col, 'X');
+			// we must also update stone array
 			--cur1;
-			*it = *cur1;
-			*cur1 = ind;
+			stone.put(ind, cur1);
 			break;
 		}
 		case true:
 		{
 			// update whitecol:
-			whitecol[col] |= uint32_t(1) << row;
-			auto it = find(cur0, cur1, ind);
-			// we must swap two stones
-			*it = *cur0;
-			*cur0 = ind;
+			whitecol[col] |= Row(1) << row;
+			links.place(row, col, 'O');
+			stone.put(ind, cur0);
 			cur0++;
 			break;
 		}
 		}
+		hash ^= zobrist_key(ind, whites_move);
+		rhash ^= zobrist_key(mirror(ind), whites_move);
+		tree.advance(ind);
 		return 0;
 	}
 	// main loop
@@ -446,134 +1539,158 @@ public:
 		}
 	}
 
+	// plays a game of the text protocol of the README on cin and cout,
+	// see play_protocol() in engine.h
 	int autoplay(char color, unsigned short board_side = 11,
-				size_t iter = 1000) {
+				size_t iter = 1000, size_t threads = 1) {
 		nshuffles = iter; // nshuffles is the number of iterations
-		char column; // letter representing board column from a-z
-		unsigned short col; // numeric column
-		unsigned short row; // numeric row
-		char c; // used for input processing
-		size_t move; // result of calling make_move()
-		// send handshake message color: name of program by author
-		// this string should uniquely identify the player
-		cout << color << ": hexai by Alexandre Kharlamov\n" << flush;
-		if(color == 'X') {
-			// wait for other player's handshake message
-			cin >> c; // should be the other player's color
-			if(c != 'O') {
-				cout << "X. E: expecting handshake message "
-					"from O\n" << flush;
-				return -2;
-			}
-			cin >> c; // should be ':'
-			if(c != ':') {
-				cout << "X. E: expecting : after O in "
-					"handshake message\n" << flush;
-				return -3;
-			}
-			// ignore the rest of the line
-			cin.clear();
-			cin.ignore(numeric_limits<streamsize>::max(), '\n');
-			// start the timer
-			auto start = std::chrono::steady_clock::now();
-			// make a move
-			move = make_move();
-						// stop the timer
-			auto end = std::chrono::steady_clock::now();
-			int tmilli = std::chrono::duration<double, std::milli>
-				(end - start).count();
-			cout << color << char((move % side) + 'a') <<
-				(move / side + 1) << " #1 t=" <<
-				tmilli << "ms\n" << flush;
-			whites_move = true;
-		}
-		int counter = 1; // count the moves
-		while(winner == ' ' && cur0 != cur1) {
-			cin >> c; // other player color
-			cin >> column; // lower case letter represenging column
-			if(c != (color=='O'?'X':'O') || column == ':') {
-				cin.clear();
-				cin.ignore(numeric_limits<streamsize>::max(),
-					'\n');
-				continue;
-			}
-			if(column == '.') { // the other player quits, game over
-				break;
-			}
-			col = column - 'a';
-			if(col >= board_side) {
-				cout << color <<  ". E: " << color <<
-				" received illegal column: '" << c << "'\n";
-				return -4;
-			}
-			cin >> row;
-			if(row > board_side) {
-				cout << color << ". E: " << color <<
-				" received illegal row: '" << row << "'\n";
-				return -5;
-			}
-			c = cin.peek();
-			if(c == '.') { // dot at the end of the other player's
-				// move means that he wins,
-				// or maybe he gives up - game over
-				break;
-			}
-			cin.clear();
-			cin.ignore(numeric_limits<streamsize>::max(), '\n');
-			// start the timer
-			auto start = std::chrono::steady_clock::now();
-			// register the opponent's move
-			int err = try_move(row - 1, col);
-			if(err) {
-				cout << color << ". E: " << " received illegal "
-					<< "move " << column << row << " " <<
-					err << '\n';
-				return -6;
-			}
-			// check if game is over
-			check_game_over(); // sets the winner variable if needed
-			if(winner != ' ') {
-				break;
-			}
-			// toggle current player
-			whites_move = whites_move? false: true;
-			if(color == 'X') {
-				++counter;
-			}
-			// make a move. If I won, add a dot and exit.
-			move = make_move();
-			// check if game is over
-			check_game_over(); // sets the winner variable if needed
-			// stop the timer
-			auto end = std::chrono::steady_clock::now();
-			int tmilli = std::chrono::duration<double, std::milli>
-				(end - start).count();
-			cout << color << char((move % side) + 'a') <<
-				(move / side + 1) <<
-				(winner != ' '? '.': ' ') << '#' << counter
-				<< " t=" << tmilli << "ms\n" << flush;
-			if(winner != ' ') {
-				break;
-			}
-			// toggle current player
-			whites_move = whites_move? false: true;
-			if(color == 'O') {
-				++counter;
-			}
+		if(threads != workers.size()) {
+			set_threads(threads);
 		}
-		return 0;
+		return play_protocol(*this, color, board_side, pondering, prune);
+	}
+	// the Engine interface, see engine.h
+	const char *name() const {
+		return "hexai by Alexandre Kharlamov";
+	}
+	void set_budget(size_t iterations, double move_ms, double game_ms) {
+		set_iterations(iterations);
+		set_clock(move_ms, game_ms);
+	}
+	void new_game() {
+		reset(black_ai, white_ai);
+	}
+	bool apply_move(size_t t) {
+		return t < size && !play_move(t);
 	}
 };
 
-// usage: <program name> (X|O) [<board side>] [<iterations>]
-// example: hex X 11 1000
+template<int Side>
+const int SizedBoard<Side>::side;
+template<int Side>
+const size_t SizedBoard<Side>::size;
+
+template<int Side>
+Board *new_board(bool aiblack, bool aiwhite) {
+	return new SizedBoard<Side>(aiblack, aiwhite);
+}
+
+// fills table[side - 3] with the constructor of every side from 3 to Side
+template<int Side>
+struct BoardMakers {
+	static void fill(Board *(**table)(bool, bool)) {
+		table[Side - 3] = new_board<Side>;
+		BoardMakers<Side - 1>::fill(table);
+	}
+};
+
+template<>
+struct BoardMakers<2> {
+	static void fill(Board *(**)(bool, bool)) {}
+};
+
+Board *Board::create(unsigned side, bool aiblack, bool aiwhite) {
+	static Board *(*table[MAX_SIDE - 2])(bool, bool);
+	static bool filled = (BoardMakers<MAX_SIDE>::fill(table), true);
+	(void)filled;
+	side = side < 3? 3: side > MAX_SIDE? MAX_SIDE: side;
+	return table[side - 3](aiblack, aiwhite);
+}
+
+// usage: <program name> (X|O) [<board side>] [<iterations>] [<threads>]
+// example: hex X 11 1000 4
+// threads = 0 uses one thread per hardware core
+// <program name> B [<board side>] [<playouts>] runs the playout benchmark
+// options of the form name=value may be given anywhere after the program name:
+// search=flat|halving|mcts   how playouts are shared among candidates
+// nodes=<n>   nodes in each of the two arenas of the mcts tree
+// time=<ms>   think for ms per move instead of counting iterations
+// clock=<ms>   think for ms for the whole game, spread over the moves
+// ponder=on|off   think on the opponent's time in autoplay
+// tt=<megabytes>   size of the transposition table, 0 (default) = none
+// amaf=on|off   rank candidates by RAVE: direct and all-moves-as-first
+// rave=<n>   playouts at which the two weigh about the same, 1000 by default
+// book=<file>   play the moves of an opening book made by bookgen
+// prune=on|off   leave out dead and captured tiles, reported as p=<n>
+// solve=<n>   solve positions with at most n empty tiles exactly, 0 = never
+// solve_nodes=<n>   positions the solver may search per move, 1000000 default
+#ifndef HEXAI_NO_MAIN // bookgen.cpp includes this file for the Board
 main(int argc, char *argv[]) {
 	char color = 'X'; // can be X or O
 	unsigned short board_side = 11; // side of the board minimum 3
 	size_t iter = 1000; // number of iterations should be selectable
+	size_t threads = 1; // number of search threads
+	Board::Search search = Board::flat; // search=... option
+	size_t tree_nodes = 1 << 20; // nodes=... option
+	double move_ms = 0, game_ms = 0; // time=... and clock=... options
+	bool ponder = false; // ponder=... option
+	size_t tt_mb = 0; // tt=... option
+	bool amaf = false; // amaf=... option
+	double rave = 1000; // rave=... option
+	string book; // book=... option
+	bool prune = false; // prune=... option
+	size_t solve = 0; // solve=... option
+	size_t solve_nodes = 1000000; // solve_nodes=... option
+	// take out the name=value options, leaving the positional parameters
+	int nargs = 1;
+	for(int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		size_t eq = arg.find('=');
+		if(eq == string::npos) {
+			argv[nargs++] = argv[i];
+			continue;
+		}
+		string name = arg.substr(0, eq), value = arg.substr(eq + 1);
+		if(name == "search" && value == "flat") {
+			search = Board::flat;
+		} else if(name == "search" && value == "halving") {
+			search = Board::halving;
+		} else if(name == "search" && value == "mcts") {
+			search = Board::mcts;
+		} else if(name == "nodes") {
+			stringstream ss(value);
+			ss >> tree_nodes;
+		} else if(name == "ponder" && (value == "on" || value == "off")) {
+			ponder = value == "on";
+		} else if(name == "tt") {
+			stringstream ss(value);
+			ss >> tt_mb;
+		} else if(name == "amaf" && (value == "on" || value == "off")) {
+			amaf = value == "on";
+		} else if(name == "rave") {
+			stringstream ss(value);
+			ss >> rave;
+		} else if(name == "book") {
+			book = value;
+		} else if(name == "prune" && (value == "on" || value == "off")) {
+			prune = value == "on";
+		} else if(name == "solve") {
+			stringstream ss(value);
+			ss >> solve;
+		} else if(name == "solve_nodes") {
+			stringstream ss(value);
+			ss >> solve_nodes;
+		} else if(name == "time") {
+			stringstream ss(value);
+			ss >> move_ms;
+		} else if(name == "clock") {
+			stringstream ss(value);
+			ss >> game_ms;
+		} else {
+			cerr << "E: unknown option " << arg << '\n';
+			return -1;
+		}
+	}
+	argc = nargs;
 	// parse command line parameters
-	argc = argc > 4? 4: argc; // forward compatibility measure
+	argc = argc > 5? 5: argc; // forward compatibility measure
 	switch(argc) {
+	case 5:
+	{
+		stringstream ss;
+		ss << argv[4];
+		ss >> threads;
+	}
 	case 4:
 	{
 		stringstream ss; // used for reading numbers from strings
@@ -589,13 +1706,38 @@ main(int argc, char *argv[]) {
 	}
 	case 2:
 		color = argv[1][0];
+		if(board_side > MAX_SIDE) {
+			cerr << "E: hexai is built for boards up to " << MAX_SIDE <<
+				'x' << MAX_SIDE << ", see -DMAX_SIDE\n";
+			return -100;
+		}
+		if(color == 'B') {
+			unique_ptr<Board> board(Board::create(board_side, false,
+				false));
+			board->bench_playouts(iter);
+			return 0;
+		}
 		if(color != 'X' && color != 'O') {
 			cerr << "E: first argument must be X or O\n";
 			return -1; // there is some error
 		}
 		{
-			Board board(board_side, color == 'X', color == 'O');
-			board.autoplay(color, board_side, iter);
+			unique_ptr<Board> board(Board::create(board_side,
+				color == 'X', color == 'O'));
+			board->set_tree_nodes(tree_nodes);
+			board->set_clock(move_ms, game_ms);
+			board->set_tt(tt_mb);
+			board->set_amaf(amaf, rave);
+			board->set_prune(prune);
+			board->set_solver(solve, solve_nodes);
+			if(!book.empty() && !board->set_book(book.c_str())) {
+				cerr << "E: " << book << " is not a book for side "
+					<< board_side << '\n';
+				return -1;
+			}
+			board->set_ponder(ponder);
+			board->set_search(search);
+			board->autoplay(color, board_side, iter, threads);
 			return 0;
 		}
 	case 1: ; // no command line arguments - continue with interactive play
@@ -608,11 +1750,30 @@ main(int argc, char *argv[]) {
 		cin >> p1ai;
 		cout << "White played by AI? 1=yes, 0=no: ";
 		cin >> p2ai;
-		Board board(side, p1ai, p2ai);
-		board.print();
-		//board.print_stones();
-		board.play();
+		if(!cin) {
+			break;
+		}
+		if(side > MAX_SIDE) {
+			cout << "E: hexai is built for boards up to " << MAX_SIDE <<
+				'x' << MAX_SIDE << ", see -DMAX_SIDE\n";
+			continue;
+		}
+		unique_ptr<Board> board(Board::create(side, p1ai, p2ai));
+		board->set_tree_nodes(tree_nodes);
+		board->set_clock(move_ms, game_ms);
+		board->set_tt(tt_mb);
+		board->set_amaf(amaf, rave);
+		board->set_prune(prune);
+		board->set_solver(solve, solve_nodes);
+		if(!book.empty()) {
+			board->set_book(book.c_str());
+		}
+		board->set_search(search);
+		board->print();
+		//board->print_stones();
+		board->play();
 		break;
 	}
 	return 0;
 }
+#endif
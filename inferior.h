@@ -0,0 +1,91 @@
+// Dead and captured cells, shared by hexai.cpp and hex.cpp (prune=on).
+// A stone on an empty cell is useless to a color if every two neighbours of
+// the cell that the color may still get are already joined around it, by a
+// run of the color's stones along the ring of the six neighbours (two
+// neighbours next to each other on the ring touch). Any path of that color
+// through the cell can then go around it, so the cell might as well belong
+// to the other color, and giving it to the other color does not change the
+// value of the position. This covers the usual local patterns: four
+// neighbours in a row of one color, three in a row and the one opposite of
+// the other color, two pairs facing each other, and a cell shut off by
+// stones of one color and its own edge. A cell that is useless to both
+// colors is dead, one that is useless to a single color is captured by the
+// other.
+// fill_inferior() gives these cells to the color that loses nothing by it,
+// over and over, since every filled cell can make its neighbours dead too.
+// The filled position has the same value as the original one, and playing
+// a filled cell is never better than playing one that is still empty, so
+// only the empty cells are candidates and the playouts start from the
+// filled stones. Cells outside the board count as stones of the edge: X
+// above and below, O left and right.
+#ifndef INFERIOR_H
+#define INFERIOR_H
+#include <cstddef>
+
+// the neighbours of a cell in order around it: (row, col) offsets
+static const int ring_dr[6] = {0, -1, -1, 0, 1, 1};
+static const int ring_dc[6] = {1, 1, 0, -1, -1, 0};
+
+// true if a stone of color ('X' or 'O') on the empty cell (r, c) of cells
+// (side * side chars 'X', 'O' or ' ', row by row) could never help it
+inline bool is_useless(const char *cells, int side, int r, int c,
+		char color) {
+	char ring[6];
+	for(int i = 0; i < 6; ++i) {
+		int nr = r + ring_dr[i], nc = c + ring_dc[i];
+		ring[i] = nr < 0 || nr >= side? 'X': nc < 0 || nc >= side? 'O':
+			cells[nr * side + nc];
+	}
+	char other = color == 'X'? 'O': 'X';
+	for(int i = 0; i < 6; ++i) {
+		if(ring[i] == other) {
+			continue;
+		}
+		for(int j = i + 1; j < 6; ++j) {
+			if(ring[j] == other) {
+				continue;
+			}
+			// joined one way or the other around the ring?
+			bool forth = true, back = true;
+			for(int k = i + 1; k < j; ++k) {
+				forth = forth && ring[k] == color;
+			}
+			for(int k = j + 1; k < i + 6; ++k) {
+				back = back && ring[k % 6] == color;
+			}
+			if(!forth && !back) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// gives every dead or captured empty cell of cells to the color that can
+// have it, see above. Returns the number of cells filled
+inline size_t fill_inferior(char *cells, int side) {
+	size_t filled = 0;
+	for(bool changed = true; changed; ) {
+		changed = false;
+		for(int r = 0; r < side; ++r) {
+			for(int c = 0; c < side; ++c) {
+				char &cell = cells[r * side + c];
+				if(cell != ' ') {
+					continue;
+				}
+				if(is_useless(cells, side, r, c, 'X')) {
+					cell = 'O';
+				} else if(is_useless(cells, side, r, c, 'O')) {
+					cell = 'X';
+				} else {
+					continue;
+				}
+				++filled;
+				changed = true;
+			}
+		}
+	}
+	return filled;
+}
+
+#endif
@@ -0,0 +1,385 @@
+// Plays tournaments between hexai and hex in one process, see engine.h.
+// to compile: g++ -O3 -std=c++11 -pthread -o match match.cpp
+// usage: match <games> "<engine> [<iterations>] [name=value ...]"
+//	"<engine> [<iterations>] [name=value ...]" [more engines ...]
+//	[<log file>] [<board side>] [jobs=<n>] [alternate=on|off]
+// example: match 100 "hex 2000" "hexai 1000 search=mcts" log3.txt jobs=0
+// <engine> is hexai or hex, followed by its iterations (1000 by default)
+// and the options its program takes on the command line, except
+// ponder=..., since the engines of a game take turns here, and threads=<n>
+// for their 4th parameter. hex plays on boards up to 16x16, and the log
+// holds boards up to 26x26, since its columns are the letters a to z.
+// Every two engines play <games> games. The first one listed plays X in the
+// first game, and they change colors every game unless alternate=off.
+// jobs=<n> plays n games at once, each on its own thread, 0 means one per
+// hardware core (1 by default). Engines that play on time get less of a
+// core when there are more jobs than cores.
+// The moves are written to the log file (log.txt by default) just like arbi
+// does, one whole game at a time, so the analyze program reads it the same
+// way. The games won by every engine, as X and as O, are printed at the
+// end. The engines talk to each other by plain function calls: no
+// processes, pipes or parsing, so short games are not slowed down by the
+// protocol. Every game starts with new engines, like it would with arbi.
+#define HEXAI_NO_MAIN
+#include "hexai.cpp"
+#define HEX_NO_MAIN
+#include "hex.cpp"
+#include <fstream>
+#include <ctime>
+#include <mutex>
+
+// an engine as given on the command line
+struct EngineSpec {
+	string text; // as given, for the log
+	string program; // hexai or hex
+	size_t iter{1000}; // iterations
+	vector<pair<string, string> > options; // name=value
+};
+
+// reads spec from the text of a command line argument, false if it is not
+// hexai or hex
+bool parse_spec(const string &text, EngineSpec &spec) {
+	stringstream ss(text);
+	string word;
+	spec.text = text;
+	ss >> spec.program;
+	while(ss >> word) {
+		size_t eq = word.find('=');
+		if(eq == string::npos) {
+			stringstream num(word);
+			num >> spec.iter;
+		} else {
+			spec.options.push_back(make_pair(word.substr(0, eq),
+				word.substr(eq + 1)));
+		}
+	}
+	return spec.program == "hexai" || spec.program == "hex";
+}
+
+// hexai with the options of spec, nullptr after an error
+Engine *create_hexai(const EngineSpec &spec, unsigned side, uint32_t seed) {
+	unique_ptr<Board> board(Board::create(side, true, true));
+	board->set_seed(seed);
+	double move_ms = 0, game_ms = 0;
+	bool amaf = false;
+	double rave = 1000;
+	size_t solve = 0, solve_nodes = 1000000;
+	for(auto &o : spec.options) {
+		const string &name = o.first, &value = o.second;
+		stringstream ss(value);
+		if(name == "search" && value == "flat") {
+			board->set_search(Board::flat);
+		} else if(name == "search" && value == "halving") {
+			board->set_search(Board::halving);
+		} else if(name == "search" && value == "mcts") {
+			board->set_search(Board::mcts);
+		} else if(name == "nodes") {
+			size_t n = 0;
+			ss >> n;
+			board->set_tree_nodes(n);
+		} else if(name == "threads") {
+			size_t n = 1;
+			ss >> n;
+			board->set_threads(n);
+		} else if(name == "tt") {
+			size_t mb = 0;
+			ss >> mb;
+			board->set_tt(mb);
+		} else if(name == "amaf" && (value == "on" || value == "off")) {
+			amaf = value == "on";
+		} else if(name == "rave") {
+			ss >> rave;
+		} else if(name == "book") {
+			if(!board->set_book(value.c_str())) {
+				cerr << "E: " << value << " is not a book for side "
+					<< side << '\n';
+				return nullptr;
+			}
+		} else if(name == "prune" && (value == "on" || value == "off")) {
+			board->set_prune(value == "on");
+		} else if(name == "solve") {
+			ss >> solve;
+		} else if(name == "solve_nodes") {
+			ss >> solve_nodes;
+		} else if(name == "time") {
+			ss >> move_ms;
+		} else if(name == "clock") {
+			ss >> game_ms;
+		} else {
+			cerr << "E: unknown hexai option " << name << '=' <<
+				value << '\n';
+			return nullptr;
+		}
+	}
+	board->set_amaf(amaf, rave);
+	board->set_solver(solve, solve_nodes);
+	board->set_budget(spec.iter, move_ms, game_ms);
+	return board.release();
+}
+
+// hex with the options of spec, nullptr after an error
+Engine *create_hex(const EngineSpec &spec, unsigned side, uint32_t seed) {
+	unique_ptr<HexEngineBase> engine(HexEngineBase::create(side, seed));
+	if(!engine) {
+		cerr << "E: hex can only play on boards up to " << maxSize << 'x' <<
+			maxSize << '\n';
+		return nullptr;
+	}
+	MoveClock clock;
+	for(auto &o : spec.options) {
+		const string &name = o.first, &value = o.second;
+		stringstream ss(value);
+		double ms = 0;
+		if(name == "threads") {
+			uint32_t n = 1;
+			ss >> n;
+			engine->set_threads(n);
+		} else if(name == "search" && value == "flat") {
+			engine->set_search(Search::Flat);
+		} else if(name == "search" && value == "halving") {
+			engine->set_search(Search::Halving);
+		} else if(name == "tt") {
+			size_t mb = 0;
+			ss >> mb;
+			engine->set_tt(mb);
+		} else if(name == "book") {
+			if(!engine->set_book(value.c_str())) {
+				cerr << "E: " << value << " is not a book for side "
+					<< side << '\n';
+				return nullptr;
+			}
+		} else if(name == "prune" && (value == "on" || value == "off")) {
+			engine->set_prune(value == "on");
+		} else if(name == "crn" && (value == "on" || value == "off")) {
+			engine->set_crn(value == "on");
+		} else if(name == "time") {
+			ss >> ms;
+			clock.set_move_time(ms);
+		} else if(name == "clock") {
+			ss >> ms;
+			clock.set_game_time(ms);
+		} else {
+			cerr << "E: unknown hex option " << name << '=' << value <<
+				'\n';
+			return nullptr;
+		}
+	}
+	engine->set_budget(spec.iter);
+	engine->set_clock(clock);
+	return engine.release();
+}
+
+Engine *create_engine(const EngineSpec &spec, unsigned side, uint32_t seed) {
+	if(spec.program == "hex") {
+		return create_hex(spec, side, seed);
+	}
+	return create_hexai(spec, side, seed);
+}
+
+// plays one game of x against o and writes its moves to log like the
+// programs would. Returns the winner, ' ' if an engine played an illegal
+// move
+char play_game(Engine &x, Engine &o, unsigned side, ostream &log) {
+	Engine *player[2] = {&x, &o};
+	x.new_game();
+	o.new_game();
+	log << "X: " << x.name() << "\nO: " << o.name() << '\n';
+	for(size_t ply = 0; x.get_winner() == ' '; ++ply) {
+		char color = ply % 2? 'O': 'X';
+		Engine &e = *player[ply % 2];
+		auto start = chrono::steady_clock::now();
+		e.think();
+		size_t move = e.best_move();
+		int tmilli = chrono::duration<double, milli>
+			(chrono::steady_clock::now() - start).count();
+		if(!x.apply_move(move) || !o.apply_move(move)) {
+			log << color << ". E: illegal move " << move << '\n';
+			return ' ';
+		}
+		bool over = x.get_winner() != ' ';
+		log << color << char(move % side + 'a') << move / side + 1 <<
+			(over? '.': ' ') << '#' << ply / 2 + 1 << " t=" << tmilli <<
+			"ms\n";
+	}
+	if(o.get_winner() != x.get_winner()) {
+		log << "X. E: the engines disagree on the winner\n";
+		return ' ';
+	}
+	return x.get_winner();
+}
+
+string now() {
+	time_t t = time(nullptr);
+	string s = ctime(&t);
+	return s.substr(0, s.size() - 1); // without the '\n'
+}
+
+// one game of the tournament: the engines playing X and O, by their index
+// in the list of the command line, and the seeds for their random engines
+struct Pairing {
+	size_t x, o;
+	uint32_t x_seed, o_seed;
+	char winner; // after the game
+};
+
+// games won by an engine of the command line
+struct Score {
+	size_t games{0};
+	size_t x_games{0}, x_wins{0};
+	size_t o_games{0}, o_wins{0};
+};
+
+// plays the games of pairings on jobs threads at once. Every game is
+// written to log in one piece when it is over, so the games of different
+// threads do not mix, and the result is printed to cout
+void play_games(vector<Pairing> &pairings, const vector<EngineSpec> &spec,
+		unsigned side, size_t jobs, ostream &log) {
+	mutex out; // guards log, cout and done
+	size_t done = 0;
+	atomic<size_t> next(0);
+	auto worker = [&]() {
+		for(size_t g; (g = next++) < pairings.size(); ) {
+			Pairing &p = pairings[g];
+			unique_ptr<Engine> x(create_engine(spec[p.x], side,
+				p.x_seed));
+			unique_ptr<Engine> o(create_engine(spec[p.o], side,
+				p.o_seed));
+			stringstream game;
+			// Match_<side> tells analyze the board side
+			game << "Match_" << side << " X: " << spec[p.x].text <<
+				" vs O: " << spec[p.o].text << " on " << now() <<
+				'\n';
+			p.winner = play_game(*x, *o, side, game);
+			game << "Ended on " << now() << "\n\n";
+			lock_guard<mutex> lock(out);
+			log << game.str() << flush;
+			cout << "game " << ++done << " of " << pairings.size() <<
+				": " << spec[p.x].text << " vs " << spec[p.o].text <<
+				": " << (p.winner == ' '? '-': p.winner) << endl;
+		}
+	};
+	vector<thread> threads;
+	for(size_t i = 1; i < jobs; ++i) {
+		threads.push_back(thread(worker));
+	}
+	worker();
+	for(auto &t : threads) {
+		t.join();
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 4) {
+		cerr << "Usage: " << argv[0] << " <games> \"<engine> [<iterations>]"
+			" [name=value ...]\" \"<engine> ...\" [\"<engine> ...\" ...]"
+			" [<log file>] [<board side>] [jobs=<n>]"
+			" [alternate=on|off]\nExample: " << argv[0] <<
+			" 100 \"hex 2000\" \"hexai 1000 search=mcts\" log3.txt"
+			" jobs=0\n";
+		return 0;
+	}
+	size_t games = 1;
+	unsigned short side = 11;
+	string path = "log.txt";
+	size_t jobs = 1; // jobs=... option
+	bool alternate = true; // alternate=... option
+	// take out the name=value options of match itself, those of the
+	// engines are inside their quotes
+	int nargs = 1;
+	for(int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		size_t eq = arg.find('=');
+		if(eq == string::npos || arg.find(' ') != string::npos) {
+			argv[nargs++] = argv[i];
+			continue;
+		}
+		string name = arg.substr(0, eq), value = arg.substr(eq + 1);
+		if(name == "jobs") {
+			stringstream ss(value);
+			ss >> jobs;
+		} else if(name == "alternate" && (value == "on" ||
+				value == "off")) {
+			alternate = value == "on";
+		} else {
+			cerr << "E: unknown option " << arg << '\n';
+			return -1;
+		}
+	}
+	argc = nargs;
+	if(!jobs) {
+		jobs = thread::hardware_concurrency();
+		jobs = jobs? jobs: 1;
+	}
+	stringstream(argv[1]) >> games;
+	// the engines, up to the first argument that is not one
+	vector<EngineSpec> spec;
+	int arg = 2;
+	for(EngineSpec e; arg < argc && parse_spec(argv[arg], e); ++arg) {
+		spec.push_back(e);
+		e = EngineSpec();
+	}
+	if(spec.size() < 2) {
+		cerr << "E: expecting at least two engines, hexai or hex\n";
+		return -1;
+	}
+	if(arg < argc) {
+		path = argv[arg++];
+	}
+	if(arg < argc) {
+		stringstream(argv[arg++]) >> side;
+		side = side < 3? 3: side;
+	}
+	if(side > 26) {
+		// the log writes columns as letters a to z
+		cerr << "E: the log can only hold boards up to 26x26\n";
+		return -1;
+	}
+	for(auto &e : spec) { // check the options before the first game
+		unique_ptr<Engine> engine(create_engine(e, side, 0));
+		if(!engine) {
+			return -1;
+		}
+	}
+	ofstream log(path, ios::app);
+	if(!log) {
+		cerr << "can't open log file " << path << '\n';
+		return -2;
+	}
+	// every two engines play games games, taking turns at X
+	random_device rd;
+	vector<Pairing> pairings;
+	for(size_t i = 0; i < spec.size(); ++i) {
+		for(size_t j = i + 1; j < spec.size(); ++j) {
+			for(size_t g = 0; g < games; ++g) {
+				bool swap = alternate && g % 2;
+				Pairing p = {swap? j: i, swap? i: j, rd(), rd(),
+					' '};
+				pairings.push_back(p);
+			}
+		}
+	}
+	auto start = chrono::steady_clock::now();
+	play_games(pairings, spec, side, min(jobs, pairings.size()), log);
+	double secs = chrono::duration<double>(chrono::steady_clock::now() -
+		start).count();
+	vector<Score> score(spec.size());
+	for(auto &p : pairings) {
+		++score[p.x].games;
+		++score[p.o].games;
+		++score[p.x].x_games;
+		++score[p.o].o_games;
+		score[p.x].x_wins += p.winner == 'X';
+		score[p.o].o_wins += p.winner == 'O';
+	}
+	for(size_t i = 0; i < spec.size(); ++i) {
+		const Score &s = score[i];
+		cout << spec[i].text << ": won " << s.x_wins + s.o_wins <<
+			" of " << s.games << ", " << s.x_wins << " of " <<
+			s.x_games << " as X, " << s.o_wins << " of " <<
+			s.o_games << " as O\n";
+	}
+	cout << pairings.size() << " games in " << secs << "s on " <<
+		min(jobs, pairings.size()) << " threads, " <<
+		pairings.size() * 3600 / secs << " games per hour\n";
+	return 0;
+}
@@ -0,0 +1,150 @@
+// Search tree of the UCT engine of hexai.cpp (search=mcts).
+// All nodes live in one preallocated arena and the children of a node are
+// stored next to each other, so a node only needs the index of its first
+// child and their count, and choosing a child reads one contiguous block.
+// The arena is never freed during a game: once our move and the opponent's
+// reply are known, advance() walks down to the matching grandchild and
+// compact() copies that subtree to the front of a second arena of the same
+// size, which then becomes the current one. Everything outside the subtree
+// is dropped in one go and the playouts inside it are kept for the next
+// search.
+#ifndef MCTS_H
+#define MCTS_H
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+struct TreeNode {
+	uint32_t first; // arena index of the first child, 0 if not expanded
+	uint16_t count; // number of children
+	uint16_t move; // tile played to reach this node
+	uint32_t visits; // playouts that went through this node
+	uint32_t wins; // of those, the ones won by the player of move
+};
+
+class SearchTree {
+	std::vector<TreeNode> arena; // current nodes, root first after compact
+	std::vector<TreeNode> spare; // compact() copies the kept subtree here
+	size_t used{0}; // nodes in use at the start of arena
+	size_t root{0}; // arena index of the root
+	bool valid{false}; // false if there is no tree to reuse
+public:
+	static constexpr double explore = 0.7; // UCB1 exploration constant
+	// allocates both arenas once, n nodes each, and drops the tree
+	void reset(size_t n) {
+		if(arena.size() != n) {
+			arena.assign(n, TreeNode());
+			spare.assign(n, TreeNode());
+		}
+		valid = false;
+	}
+	size_t capacity() const {
+		return arena.size();
+	}
+	size_t size() const {
+		return used;
+	}
+	// bytes allocated by the two arenas
+	size_t memory() const {
+		return 2 * arena.size() * sizeof(TreeNode);
+	}
+	TreeNode &node(size_t i) {
+		return arena[i];
+	}
+	// follows the move that was just played, the tree is dropped if the
+	// move has not been searched
+	void advance(size_t move) {
+		if(!valid) {
+			return;
+		}
+		TreeNode &r = arena[root];
+		for(size_t i = r.first; i < r.first + r.count; ++i) {
+			if(arena[i].move == move) {
+				root = i;
+				return;
+			}
+		}
+		valid = false;
+	}
+	// moves the root and its subtree to the front of the arena, breadth
+	// first so the children of each node stay together. Starts a new tree
+	// if there is nothing to keep. Returns the index of the root, always 0
+	size_t compact() {
+		if(!valid || !arena[root].count) {
+			arena[0] = TreeNode();
+			used = 1;
+			root = 0;
+			valid = true;
+			return root;
+		}
+		spare[0] = arena[root];
+		size_t n = 1;
+		for(size_t i = 0; i < n; ++i) {
+			TreeNode &x = spare[i];
+			if(x.count) {
+				std::copy(arena.begin() + x.first, arena.begin() +
+					x.first + x.count, spare.begin() + n);
+				x.first = n;
+				n += x.count;
+			}
+		}
+		std::swap(arena, spare);
+		used = n;
+		root = 0;
+		return root;
+	}
+	// adds children for the moves [first, last) to a leaf, fails if the
+	// arena is full
+	template<class It>
+	bool expand(size_t i, It first, It last) {
+		size_t n = last - first;
+		if(used + n > arena.size()) {
+			return false;
+		}
+		TreeNode *c = &arena[used];
+		for(It it = first; it != last; ++it, ++c) {
+			*c = TreeNode();
+			c->move = *it;
+		}
+		arena[i].first = used;
+		arena[i].count = n;
+		used += n;
+		return true;
+	}
+	// child of an expanded node with the best UCB1 score for the player to
+	// move there, children that have never been visited go first
+	size_t select(size_t i) const {
+		const TreeNode &x = arena[i];
+		double logn = std::log(double(x.visits));
+		size_t best = x.first;
+		double best_score = -1;
+		for(size_t c = x.first; c < x.first + x.count; ++c) {
+			const TreeNode &y = arena[c];
+			if(!y.visits) {
+				return c;
+			}
+			double score = double(y.wins) / y.visits +
+				explore * std::sqrt(logn / y.visits);
+			if(score > best_score) {
+				best = c;
+				best_score = score;
+			}
+		}
+		return best;
+	}
+	// child of the root with the most visits, the move to play
+	size_t best() const {
+		const TreeNode &x = arena[root];
+		size_t best = x.first;
+		for(size_t c = x.first; c < x.first + x.count; ++c) {
+			if(arena[c].visits > arena[best].visits) {
+				best = c;
+			}
+		}
+		return best;
+	}
+};
+
+#endif
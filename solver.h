@@ -0,0 +1,218 @@
+// Exact endgame solver of hexai.cpp (solve=<cells>).
+// Once few tiles are left, the random fills of the searches only estimate
+// what can be worked out exactly: a depth-first search of all the moves
+// tells whether the player to move can force a win, and with which move.
+// The search is a plain negamax over win or loss with these cutoffs:
+//  - a player who would not connect even with every empty tile has lost,
+//  - so the player to move wins at once if the opponent could not connect
+//    with every empty tile, whatever he plays,
+//  - a move that connects wins,
+//  - otherwise two tiles that would each connect the opponent lose, and
+//    a single one has to be taken, so it is the only move searched.
+// Results are kept in a small direct-mapped cache keyed by the canonical
+// Zobrist hash of transposition.h, so the stones, in whatever order they
+// were played and turned around or not, find the result again, also in the
+// searches of the following moves. The search gives up after a number of
+// nodes or at a deadline, whichever comes first, and the engine then falls
+// back to its usual search.
+// Like in hexai, black (X) keeps one bitmap per row (bit = column) and
+// connects the first row to the last, white (O) one bitmap per column (bit =
+// row) and connects the first column to the last. In both the neighbours of
+// bit j of line i are bits j - 1 and j + 1 of line i, j and j + 1 of line
+// i - 1 and j - 1 and j of line i + 1, so one connection check does both.
+#ifndef SOLVER_H
+#define SOLVER_H
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "transposition.h" // zobrist_key, canonical_key
+
+class EndgameSolver {
+public:
+	enum Result { unknown, win, loss }; // for the player to move
+private:
+	typedef std::chrono::steady_clock clock;
+	int side{0};
+	uint32_t lines[2][32]; // X rows, O columns
+	uint32_t empty[32]; // empty tiles, laid out like the X rows
+	uint64_t hash{0}, rhash{0}; // of the position and of its turn
+	std::vector<uint64_t> keys; // cache: canonical key, result in bit 0
+	size_t nodes{0}; // nodes searched so far in this solve()
+	size_t max_nodes{1000000};
+	clock::time_point deadline;
+	bool timed{false};
+	bool aborted{false};
+	// true if the lines of a color connect the first line to the last.
+	// The stones reached from the first line are grown until nothing
+	// changes, so paths that wind back are found too
+	bool connects(const uint32_t *l) const {
+		uint32_t reach[32];
+		reach[0] = l[0];
+		for(int i = 1; i < side; ++i) {
+			reach[i] = 0;
+		}
+		for(bool changed = true; changed; ) {
+			changed = false;
+			for(int i = 0; i < side; ++i) {
+				uint32_t r = reach[i];
+				if(i > 0) {
+					r |= (reach[i - 1] | reach[i - 1] >> 1) &
+						l[i];
+				}
+				if(i + 1 < side) {
+					r |= (reach[i + 1] | reach[i + 1] << 1) &
+						l[i];
+				}
+				for(uint32_t s = 0; s != r; ) { // along the line
+					s = r;
+					r |= (r << 1 | r >> 1) & l[i];
+				}
+				if(r != reach[i]) {
+					reach[i] = r;
+					changed = true;
+				}
+			}
+		}
+		return reach[side - 1] != 0;
+	}
+	// true if color (0 = X, 1 = O) would connect with all empty tiles
+	bool could_connect(int color) const {
+		uint32_t l[32] = {}; // the lines past side stay empty
+		for(int i = 0; i < side; ++i) {
+			l[i] = lines[color][i];
+		}
+		for(int r = 0; r < side; ++r) {
+			for(uint32_t e = empty[r]; e; e &= e - 1) {
+				int c = __builtin_ctz(e);
+				l[color? c: r] |= uint32_t(1) << (color? r: c);
+			}
+		}
+		return connects(l);
+	}
+	void place(int t, int color) {
+		int r = t / side, c = t % side;
+		empty[r] ^= uint32_t(1) << c;
+		lines[color][color? c: r] ^= uint32_t(1) << (color? r: c);
+		hash ^= zobrist_key(t, color);
+		rhash ^= zobrist_key(side * side - 1 - t, color);
+	}
+	uint64_t &slot(uint64_t key) {
+		return keys[key & (keys.size() - 1)];
+	}
+	// the empty tiles that would connect color at once, at most two: the
+	// first one in t, false if there are none
+	int winning_tiles(int color, int &t) {
+		int found = 0;
+		for(int r = 0; r < side && found < 2; ++r) {
+			for(uint32_t m = empty[r]; m && found < 2; m &= m - 1) {
+				int u = r * side + __builtin_ctz(m);
+				place(u, color);
+				if(connects(lines[color])) {
+					t = found? t: u;
+					++found;
+				}
+				place(u, color); // take it back
+			}
+		}
+		return found;
+	}
+	// true if color, to move, can force a win. Sets aborted and returns
+	// false when the node limit or the deadline is reached. The winning
+	// move is stored in best at the root
+	bool wins(int color, int *best) {
+		if(++nodes > max_nodes ||
+			(timed && !(nodes & 1023) && clock::now() >= deadline)) {
+			aborted = true;
+			return false;
+		}
+		uint64_t key = canonical_key(hash, rhash);
+		uint64_t &e = slot(key);
+		if(!best && (e | 1) == (key | 1)) {
+			return e & 1;
+		}
+		bool won = false;
+		int t, threat, threats;
+		if(!could_connect(color)) {
+			won = false;
+		} else if(!could_connect(!color) && !best) {
+			won = true;
+		} else if(winning_tiles(color, t)) {
+			won = true;
+			if(best) {
+				*best = t;
+			}
+		} else if((threats = winning_tiles(!color, threat)) > 1) {
+			won = false; // only one of them can be blocked
+		} else if(threats) { // it has to be blocked
+			place(threat, color);
+			won = !wins(!color, nullptr);
+			place(threat, color);
+			if(won && best) {
+				*best = threat;
+			}
+		} else {
+			for(int r = 0; r < side && !won && !aborted; ++r) {
+				for(uint32_t m = empty[r]; m && !won && !aborted;
+						m &= m - 1) {
+					t = r * side + __builtin_ctz(m);
+					place(t, color);
+					won = !wins(!color, nullptr);
+					place(t, color); // take it back
+					if(won && best) {
+						*best = t;
+					}
+				}
+			}
+		}
+		if(aborted) {
+			return false;
+		}
+		e = (key & ~uint64_t(1)) | won;
+		return won;
+	}
+public:
+	// cache of 2^bits entries of 8 bytes, the node limit of a solve()
+	void reset(int bits, size_t node_limit) {
+		keys.assign(size_t(1) << bits, 0);
+		max_nodes = node_limit;
+	}
+	size_t searched() const {
+		return nodes;
+	}
+	// solves the position of a board of side s given by its black rows
+	// and white columns, white to move if white is set, with hash h and
+	// rotated hash rh. A win comes with the winning tile in move. The
+	// search stops at until if timed is set
+	Result solve(int s, const uint32_t *blackrow, const uint32_t *whitecol,
+			bool white, uint64_t h, uint64_t rh, int &move,
+			bool timed_search = false,
+			clock::time_point until = clock::time_point()) {
+		side = s;
+		for(int i = 0; i < side; ++i) {
+			lines[0][i] = blackrow[i];
+			lines[1][i] = whitecol[i];
+		}
+		uint32_t full = side == 32? ~uint32_t(0):
+			(uint32_t(1) << side) - 1;
+		for(int r = 0; r < side; ++r) {
+			empty[r] = full & ~blackrow[r];
+			for(int c = 0; c < side; ++c) {
+				if(whitecol[c] >> r & 1) {
+					empty[r] &= ~(uint32_t(1) << c);
+				}
+			}
+		}
+		hash = h;
+		rhash = rh;
+		nodes = 0;
+		timed = timed_search;
+		deadline = until;
+		aborted = false;
+		move = -1;
+		bool won = wins(white, &move);
+		return aborted? unknown: won? win: loss;
+	}
+};
+
+#endif
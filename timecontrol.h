@@ -0,0 +1,77 @@
+// Time control shared by hexai.cpp and hex.cpp: time=<ms> gives every move
+// the same budget, clock=<ms> is a clock for the whole game, both can be
+// combined and the smaller budget wins.
+// With a game clock, the time left is shared among the moves we still
+// expect to play. Hex games end long before the board is full, often when
+// a third of the tiles are taken, so a player has roughly empty / 7 + 3
+// moves to go. The opening and the endgame get less than their share, the
+// middle game, where most games are decided, gets more: 60% for the first
+// 10% of the tiles, 150% up to 45% of the tiles and 100% after that. A
+// single move never takes more than a third of the time left.
+// The searches are anytime: they check expired() between small chunks of
+// playouts and play their best move so far when it returns true, so the
+// move times reported by the protocol stay within a chunk of the budget.
+#ifndef TIMECONTROL_H
+#define TIMECONTROL_H
+#include <chrono>
+#include <cstddef>
+
+class MoveClock {
+	typedef std::chrono::steady_clock clock;
+	double per_move{0}; // budget of every move in ms, 0 = none
+	double game{0}; // time for all our moves in ms, 0 = none
+	double used{0}; // ms used by our moves so far
+	clock::time_point started; // start of the current move
+	clock::time_point until; // deadline of the current move
+public:
+	void set_move_time(double ms) {
+		per_move = ms;
+	}
+	void set_game_time(double ms) {
+		game = ms;
+		used = 0;
+	}
+	// a new game, none of its time is used yet
+	void new_game() {
+		used = 0;
+	}
+	// false if the searches should count iterations instead
+	bool enabled() const {
+		return per_move > 0 || game > 0;
+	}
+	// budget in ms for a move with empty of the size tiles still free
+	double budget(size_t empty, size_t size) const {
+		double ms = per_move > 0? per_move: 0;
+		if(game > 0) {
+			double left = game > used? game - used: 0;
+			double moves = empty / 7.0 + 3;
+			double filled = 1 - double(empty) / size;
+			double weight = filled < 0.10? 0.6: filled < 0.45? 1.5: 1;
+			double share = left * weight / moves;
+			share = share < left / 3? share: left / 3;
+			ms = ms > 0 && ms < share? ms: share;
+		}
+		return ms;
+	}
+	// starts the clock of a move
+	void start(size_t empty, size_t size) {
+		started = clock::now();
+		until = started + std::chrono::microseconds(
+			(long long)(budget(empty, size) * 1000));
+	}
+	bool expired() const {
+		return clock::now() >= until;
+	}
+	// point in time after the given fraction of the budget
+	clock::time_point split(double f) const {
+		return started + std::chrono::duration_cast<clock::duration>(
+			(until - started) * f);
+	}
+	// stops the clock of a move and adds its time to the time used
+	void stop() {
+		used += std::chrono::duration<double, std::milli>(clock::now() -
+			started).count();
+	}
+};
+
+#endif
@@ -0,0 +1,126 @@
+// Zobrist hashing and a transposition table, shared by hexai.cpp and
+// hex.cpp.
+// The hash of a position is the xor of one 64 bit key per stone, so placing
+// a stone updates it with a single xor and two move orders that reach the
+// same stones reach the same hash. The key of a stone is the SplitMix64
+// finalizer of its tile and color, which needs no table and is the same in
+// both programs. Since the players alternate, the stones also tell whose
+// move it is.
+// A position and its 180 degree turn have the same value in Hex, since each
+// color still connects the same pair of edges, so the table is keyed by
+// canonical_key(): the smaller of the hash of the position and the hash of
+// its turn, which the programs keep up to date the same way. Tile t of a
+// board with n tiles turns into n - 1 - t.
+// The table stores visits and wins of the player who made the last move
+// for each position, in buckets of two entries: the first keeps the
+// position with the most visits, the second takes whatever comes. There
+// are no locks: an entry holds its data and the key xor the data in two
+// atomic words, and a probe only accepts an entry whose words agree with
+// the key, so an entry torn by two threads writing at once reads as a miss
+// instead of as wrong statistics. Adding to an entry is not atomic as a
+// whole, so concurrent updates of the same position may lose a few counts.
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// key of a stone of color (0 = X, 1 = O) on tile
+inline uint64_t zobrist_key(size_t tile, int color) {
+	uint64_t z = (tile * 2 + color + 1) * 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+// key shared by a position with hash h and its 180 degree turn, whose
+// hash is r
+inline uint64_t canonical_key(uint64_t h, uint64_t r) {
+	return r < h? r: h;
+}
+
+class TranspositionTable {
+	struct Entry {
+		std::atomic<uint64_t> check{0}; // key ^ data
+		std::atomic<uint64_t> data{0}; // wins << 32 | visits
+	};
+	std::unique_ptr<Entry[]> entries; // two per bucket
+	size_t mask{0}; // buckets - 1, the number of buckets is a power of 2
+	static uint64_t pack(uint32_t wins, uint32_t visits) {
+		return uint64_t(wins) << 32 | visits;
+	}
+	// entry of the bucket of key that holds key, or nullptr
+	Entry *find(uint64_t key) const {
+		Entry *e = &entries[(key & mask) * 2];
+		for(int i = 0; i < 2; ++i) {
+			uint64_t d = e[i].data.load(std::memory_order_relaxed);
+			if((e[i].check.load(std::memory_order_relaxed) ^ d) == key &&
+				d) {
+				return e + i;
+			}
+		}
+		return nullptr;
+	}
+	static void write(Entry &e, uint64_t key, uint64_t d) {
+		e.data.store(d, std::memory_order_relaxed);
+		e.check.store(key ^ d, std::memory_order_relaxed);
+	}
+public:
+	// uses about megabytes of memory, 0 turns the table off
+	void resize(size_t megabytes) {
+		size_t buckets = 0;
+		size_t bytes = megabytes << 20;
+		if(bytes >= 2 * sizeof(Entry)) {
+			buckets = 1;
+			while(buckets * 4 * sizeof(Entry) <= bytes) {
+				buckets *= 2;
+			}
+		}
+		entries.reset(buckets? new Entry[buckets * 2]: nullptr);
+		mask = buckets? buckets - 1: 0;
+	}
+	bool enabled() const {
+		return entries != nullptr;
+	}
+	size_t memory() const {
+		return enabled()? (mask + 1) * 2 * sizeof(Entry): 0;
+	}
+	// statistics of the position with hash key, false if it is not stored
+	bool probe(uint64_t key, uint32_t &wins, uint32_t &visits) const {
+		Entry *e = find(key);
+		if(!e) {
+			return false;
+		}
+		uint64_t d = e->data.load(std::memory_order_relaxed);
+		wins = d >> 32;
+		visits = uint32_t(d);
+		return true;
+	}
+	// replaces the statistics of a position
+	void store(uint64_t key, uint32_t wins, uint32_t visits) {
+		if(!visits) {
+			return;
+		}
+		Entry *e = find(key);
+		if(!e) {
+			e = &entries[(key & mask) * 2];
+			if(uint32_t(e->data.load(std::memory_order_relaxed)) >
+				visits) {
+				++e; // keep the better explored position
+			}
+		}
+		write(*e, key, pack(wins, visits));
+	}
+	// adds playouts to the statistics of a position
+	void add(uint64_t key, uint32_t wins, uint32_t visits) {
+		uint32_t w = 0, v = 0;
+		probe(key, w, v);
+		if(v + visits < v) {
+			return; // keep what is there rather than overflow
+		}
+		store(key, w + wins, v + visits);
+	}
+};
+
+#endif
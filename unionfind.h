@@ -0,0 +1,100 @@
+// Incremental win detection for live games, shared by hexai.cpp and
+// analyze.cpp.
+// Every tile of the board is a node of a union-find forest, plus four
+// virtual nodes for the edges: top and bottom for black (X), left and right
+// for white (O). Placing a stone joins it with its stones of the same color
+// among its six neighbours and with the edges it touches, which takes near
+// constant time, so the game is over as soon as both edges of one color are
+// in the same set. Tile (r, c) touches (r, c - 1), (r, c + 1), (r - 1, c),
+// (r - 1, c + 1), (r + 1, c) and (r + 1, c - 1), like everywhere else.
+#ifndef UNIONFIND_H
+#define UNIONFIND_H
+#include <vector>
+#include <cstddef>
+
+class WinTracker {
+	int side;
+	std::vector<int> parent; // parent node, roots point to themselves
+	std::vector<int> rank; // upper bound of the tree height of a root
+	std::vector<char> color; // 'X', 'O' or ' ' for every tile
+	char won{' '}; // ' ' while the game is running, else 'X' or 'O'
+	int top() const { return side * side; }
+	int bottom() const { return side * side + 1; }
+	int left() const { return side * side + 2; }
+	int right() const { return side * side + 3; }
+	int find(int i) {
+		while(parent[i] != i) {
+			parent[i] = parent[parent[i]]; // path halving
+			i = parent[i];
+		}
+		return i;
+	}
+	void join(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if(a == b) {
+			return;
+		}
+		if(rank[a] < rank[b]) {
+			std::swap(a, b);
+		}
+		parent[b] = a;
+		if(rank[a] == rank[b]) {
+			++rank[a];
+		}
+	}
+public:
+	WinTracker() : side(0) {}
+	void reset(int side) {
+		this->side = side;
+		size_t n = side * side + 4;
+		parent.resize(n);
+		rank.assign(n, 0);
+		color.assign(side * side, ' ');
+		for(size_t i = 0; i < n; ++i) {
+			parent[i] = i;
+		}
+		won = ' ';
+	}
+	// puts a stone of color c ('X' or 'O') on an empty tile
+	void place(int row, int col, char c) {
+		int i = row * side + col;
+		color[i] = c;
+		static const int dr[6] = { 0, 0, -1, -1, 1, 1 };
+		static const int dc[6] = { -1, 1, 0, 1, 0, -1 };
+		for(int k = 0; k < 6; ++k) {
+			int r = row + dr[k], q = col + dc[k];
+			if(r >= 0 && r < side && q >= 0 && q < side &&
+				color[r * side + q] == c) {
+				join(i, r * side + q);
+			}
+		}
+		if(c == 'X') {
+			if(row == 0) {
+				join(i, top());
+			}
+			if(row == side - 1) {
+				join(i, bottom());
+			}
+			if(won == ' ' && find(top()) == find(bottom())) {
+				won = 'X';
+			}
+		} else {
+			if(col == 0) {
+				join(i, left());
+			}
+			if(col == side - 1) {
+				join(i, right());
+			}
+			if(won == ' ' && find(left()) == find(right())) {
+				won = 'O';
+			}
+		}
+	}
+	// ' ' while nobody has won, else the color of the winner
+	char winner() const {
+		return won;
+	}
+};
+
+#endif
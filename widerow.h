@@ -0,0 +1,157 @@
+// Rows of more than 32 tiles for hexai.cpp's boards above 32x32.
+// A row of a board up to 32x32 is a uint32_t, bit c being column c. Larger
+// boards use WideRow<W>, W 64 bit words with bit c in word c / 64, which
+// has the operators the row scans use: &, |, ^, ~ and shifts that carry the
+// bits from one word to the next, so the same code works on both. The free
+// functions below replace the builtins that only exist for integers.
+#ifndef WIDEROW_H
+#define WIDEROW_H
+#include <cstdint>
+
+template<int W>
+struct WideRow {
+	uint64_t w[W];
+	WideRow(uint64_t x = 0) {
+		w[0] = x;
+		for(int i = 1; i < W; ++i) {
+			w[i] = 0;
+		}
+	}
+	explicit operator bool() const {
+		uint64_t x = 0;
+		for(int i = 0; i < W; ++i) {
+			x |= w[i];
+		}
+		return x != 0;
+	}
+	bool operator==(const WideRow &o) const {
+		for(int i = 0; i < W; ++i) {
+			if(w[i] != o.w[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+	bool operator!=(const WideRow &o) const {
+		return !(*this == o);
+	}
+	WideRow &operator&=(const WideRow &o) {
+		for(int i = 0; i < W; ++i) {
+			w[i] &= o.w[i];
+		}
+		return *this;
+	}
+	WideRow &operator|=(const WideRow &o) {
+		for(int i = 0; i < W; ++i) {
+			w[i] |= o.w[i];
+		}
+		return *this;
+	}
+	WideRow &operator^=(const WideRow &o) {
+		for(int i = 0; i < W; ++i) {
+			w[i] ^= o.w[i];
+		}
+		return *this;
+	}
+	WideRow operator~() const {
+		WideRow r;
+		for(int i = 0; i < W; ++i) {
+			r.w[i] = ~w[i];
+		}
+		return r;
+	}
+	// bit c moves to c + n, the bits shifted out of a word go to the
+	// next one
+	WideRow operator<<(int n) const {
+		WideRow r;
+		int words = n / 64, bits = n % 64;
+		for(int i = W - 1; i >= words; --i) {
+			r.w[i] = w[i - words] << bits;
+			if(bits && i - words > 0) {
+				r.w[i] |= w[i - words - 1] >> (64 - bits);
+			}
+		}
+		return r;
+	}
+	// bit c moves to c - n
+	WideRow operator>>(int n) const {
+		WideRow r;
+		int words = n / 64, bits = n % 64;
+		for(int i = 0; i + words < W; ++i) {
+			r.w[i] = w[i + words] >> bits;
+			if(bits && i + words + 1 < W) {
+				r.w[i] |= w[i + words + 1] << (64 - bits);
+			}
+		}
+		return r;
+	}
+};
+
+template<int W>
+inline WideRow<W> operator&(WideRow<W> a, const WideRow<W> &b) {
+	return a &= b;
+}
+
+template<int W>
+inline WideRow<W> operator|(WideRow<W> a, const WideRow<W> &b) {
+	return a |= b;
+}
+
+template<int W>
+inline WideRow<W> operator^(WideRow<W> a, const WideRow<W> &b) {
+	return a ^= b;
+}
+
+// number of the lowest bit set, x must not be 0
+inline int lowest_bit(uint32_t x) {
+	return __builtin_ctz(x);
+}
+
+template<int W>
+inline int lowest_bit(const WideRow<W> &x) {
+	int i = 0;
+	while(!x.w[i]) {
+		++i;
+	}
+	return i * 64 + __builtin_ctzll(x.w[i]);
+}
+
+// x without its lowest bit
+inline uint32_t drop_lowest(uint32_t x) {
+	return x & (x - 1);
+}
+
+template<int W>
+inline WideRow<W> drop_lowest(WideRow<W> x) {
+	for(int i = 0; i < W; ++i) {
+		if(x.w[i]) {
+			x.w[i] &= x.w[i] - 1;
+			break;
+		}
+	}
+	return x;
+}
+
+// number of bits set
+inline int count_bits(uint32_t x) {
+	return __builtin_popcount(x);
+}
+
+template<int W>
+inline int count_bits(const WideRow<W> &x) {
+	int n = 0;
+	for(int i = 0; i < W; ++i) {
+		n += __builtin_popcountll(x.w[i]);
+	}
+	return n;
+}
+
+// a row of random bits, every bit set with probability 1/2
+template<class Rng, int W>
+inline void random_row(Rng &rng, WideRow<W> &x) {
+	for(int i = 0; i < W; ++i) {
+		x.w[i] = rng();
+	}
+}
+
+#endif
@@ -0,0 +1,76 @@
+// Thread pool shared by the searches of hexai.cpp and hex.cpp.
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+// WorkerPool keeps a fixed number of threads alive between moves so that the
+// Monte-Carlo search can use all cores without starting new threads for every
+// move. run() calls the job with worker number 0 on the calling thread and
+// with numbers 1 .. size()-1 on the pool threads, and returns when all of
+// them are done.
+class WorkerPool {
+	std::vector<std::thread> threads; // the caller is worker 0
+	std::mutex m; // protects everything below
+	std::condition_variable start_cv, done_cv;
+	std::function<void(size_t)> job; // current job, takes the worker number
+	size_t generation{0}; // incremented every time a new job is posted
+	size_t pending{0}; // number of pool threads still running the job
+	bool quit{false}; // set by destructor to stop the threads
+	void loop(size_t id) {
+		size_t seen = 0; // last generation this thread has run
+		std::unique_lock<std::mutex> lock(m);
+		while(true) {
+			start_cv.wait(lock, [&] {
+				return quit || generation != seen;
+			});
+			if(quit) {
+				return;
+			}
+			seen = generation;
+			lock.unlock();
+			job(id);
+			lock.lock();
+			if(!--pending) {
+				done_cv.notify_one();
+			}
+		}
+	}
+public:
+	WorkerPool(size_t n) {
+		for(size_t i = 1; i < n; ++i) {
+			threads.emplace_back(&WorkerPool::loop, this, i);
+		}
+	}
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(m);
+			quit = true;
+		}
+		start_cv.notify_all();
+		for(auto &t : threads) {
+			t.join();
+		}
+	}
+	size_t size() {
+		return threads.size() + 1;
+	}
+	void run(const std::function<void(size_t)> &f) {
+		{
+			std::lock_guard<std::mutex> lock(m);
+			job = f;
+			pending = threads.size();
+			++generation;
+		}
+		start_cv.notify_all();
+		f(0); // the calling thread does its share of the work too
+		std::unique_lock<std::mutex> lock(m);
+		done_cv.wait(lock, [&] { return !pending; });
+	}
+};
+
+#endif